@@ -1,5 +1,6 @@
 #pragma once
 
+#include <acul/enum.hpp>
 #include <acul/hash/hashmap.hpp>
 #include <acul/hash/utils.hpp>
 #include <acul/io/path.hpp>
@@ -17,12 +18,27 @@
 
 namespace umbf
 {
+    /// Returns a value never returned before in this process. Used to stamp block generations.
+    UMBF_EXPORT u64 next_block_generation();
+
     // Meta
     struct Block
     {
+        u64 generation = next_block_generation(); ///< Stamp of the block contents, see `touch`.
+
         virtual ~Block() = default;
 
         virtual u32 signature() const = 0;
+
+        /// Marks the block as edited in place so cached writes of its owners are refreshed.
+        void touch() { generation = next_block_generation(); }
+    };
+
+    /// Serialized bytes of a block list and the generations of the blocks they were written from.
+    struct WriteCache
+    {
+        acul::vector<char> bytes;
+        acul::vector<u64> generations;
     };
 
     /**
@@ -48,6 +64,9 @@ namespace umbf
         Payload blocks;
         u32 checksum; //< Checksum of the asset for integrity validation.
 
+        bool dirty = true; //< Set after editing the header. Cleared when a scene write caches its bytes.
+        acul::shared_ptr<WriteCache> write_cache; //< Last cached write, see `Scene::cache_writes`.
+
         /**
          * @brief Reads and creates an asset from a binary stream.
          * @param bytes The binary stream containing the asset data.
@@ -112,13 +131,27 @@ namespace umbf
             image = 0x7684573F,
             image_atlas = 0xA3903A92,
             material = 0xA8D0C51E,
-            scene = 0xB7A3EE80,
-            mesh = 0xF224B521,
-            material_range = 0xC441E54D,
+            scene = 0x2D442702,
+            scene_v1 = 0xB7A3EE80,
+            mesh = 0x95266F93,
+            mesh_v1 = 0xF224B521,
+            compact_mesh = 0x3771B31B,
+            meshlets = 0x99967E0F,
+            lod_chain = 0x91A323B0,
+            draw_ranges = 0x252C4BFF,
+            vertex_attributes = 0xC1D8E929,
+            bvh = 0x0C35596D,
+            scene_index = 0xE461DCD9,
+            mesh_instance = 0xA3BB7C12,
+            scene_cells = 0x5145C122,
+            material_range = 0x1321D6DB,
+            material_range_v1 = 0xC441E54D,
             material_info = 0x6112A229,
             target = 0x0491F4E9,
-            library = 0x8D7824FA,
-            mapping = 0x3AC46A57
+            library = 0xB9AF784D,
+            library_v1 = 0x8D7824FA,
+            mapping = 0x3AC46A57,
+            inline_mapping = 0x2DD44EC0
         };
     } // namespace sign_block
 
@@ -249,6 +282,9 @@ namespace umbf
         u64 id;                                     //< Unique identifier for the object.
         acul::string name;                          //< The name of the object.
         acul::vector<acul::shared_ptr<Block>> meta; //< Metadata associated with the object.
+
+        bool dirty = true; //< Forces the next cached write to serialize the meta again.
+        acul::shared_ptr<WriteCache> write_cache; //< Meta bytes of the last cached write.
     };
 
     /**
@@ -263,6 +299,15 @@ namespace umbf
         acul::vector<File> textures;  //< Array of texture assets used in the scene.
         acul::vector<File> materials; //< Array of material assets used in the scene.
 
+        /**
+         * Keep the serialized bytes of every object meta list and embedded file on write. The next write copies
+         * the bytes of an object or file instead of serializing it again when it is not `dirty` and its block
+         * list still holds blocks of the same generations. Adding, removing or replacing blocks is detected
+         * automatically; call `Block::touch` after editing a block in place. The utilities of this library
+         * touch the blocks they edit.
+         */
+        bool cache_writes = false;
+
         /**
          * @brief Returns the signature of the scene block.
          *
@@ -272,6 +317,45 @@ namespace umbf
          * @return The signature of the block.
          */
         virtual u32 signature() const override { return sign_block::scene; }
+
+        /**
+         * @brief Finds an object by id.
+         *
+         * Lookups use indexes that are built on first use and kept until invalidate_lookup() is called. Call it
+         * after any change to `objects`: adding, removing or reordering objects, or editing ids, names or meta
+         * block lists. Utilities of this library that change a scene invalidate the indexes themselves. As a
+         * safety net, a change of the object count or a hit on an object with another id or name rebuilds the
+         * indexes, so a missed invalidation never yields a dangling pointer, only possibly stale misses.
+         * First use is not thread-safe, call build_lookup() before concurrent access.
+         * @return Pointer to the object or nullptr if it is not found.
+         */
+        UMBF_EXPORT Object *find_object(u64 id);
+        UMBF_EXPORT const Object *find_object(u64 id) const;
+
+        /// @brief Finds the first object with the given name. See find_object(u64) for index rules.
+        UMBF_EXPORT Object *find_object(const acul::string &name);
+        UMBF_EXPORT const Object *find_object(const acul::string &name) const;
+
+        /// @brief Returns indices of objects that carry a meta block with the given signature, in object order.
+        /// Indices are always in range, see find_object(u64) for index rules.
+        UMBF_EXPORT const acul::vector<u32> &objects_with(u32 signature) const;
+
+        /// @brief Builds lookup indexes if they are missing
+        UMBF_EXPORT void build_lookup() const;
+
+        /// @brief Drops lookup indexes. They are rebuilt by the next lookup.
+        void invalidate_lookup() { _lookup.valid = false; }
+
+    private:
+        struct Lookup
+        {
+            acul::hashmap<u64, u32> ids;
+            acul::hashmap<acul::string, u32> names;
+            acul::hashmap<u32, acul::vector<u32>> signatures;
+            size_t object_count = 0; ///< Size of `objects` when the indexes were built.
+            bool valid = false;
+        };
+        mutable Lookup _lookup;
     };
 
     namespace mesh
@@ -307,6 +391,72 @@ namespace umbf
             acul::vector<u32> faces;    ///< List of indices of faces that reference these vertices.
         };
 
+        /**
+         * @brief Vertex group adjacency in compact (CSR) form. Help structure. Not used directly in the UMBF Mesh.
+         *
+         * References of group `g` occupy the range `[offsets[g], offsets[g + 1])` of `faces` and `vertices`,
+         * in the order faces reference the group.
+         */
+        struct VertexGroupTable
+        {
+            acul::vector<u32> offsets;  ///< Group ranges. Holds group count + 1 entries.
+            acul::vector<u32> faces;    ///< Indices of faces that reference each group.
+            acul::vector<u32> vertices; ///< Indices of vertices referenced through each group.
+
+            size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+            u32 count(size_t group) const { return offsets[group + 1] - offsets[group]; }
+        };
+
+        // Classification of an undirected edge in a half-edge table.
+        struct EdgeFlagBits
+        {
+            enum enum_type : u8
+            {
+                none = 0x0,
+                boundary = 0x1,     ///< Used by a single half-edge.
+                non_manifold = 0x2, ///< Used by more than two half-edges or by two with the same direction.
+                seam = 0x4          ///< Shared by two faces that reference different vertices of the same groups.
+            };
+            using flag_bitmask = std::true_type;
+        };
+
+        using EdgeFlags = acul::flags<EdgeFlagBits>;
+
+        /**
+         * @brief Half-edge adjacency of a model. Help structure. Not used directly in the UMBF Mesh.
+         *
+         * Face `f` owns half-edges `[offsets[f], offsets[f + 1])`, in the order of its vertex references.
+         * Half-edge `h` leads from reference `k` to reference `k + 1` of its face. Edges are matched on vertex
+         * groups, so faces stay connected across UV and normal seams.
+         */
+        struct HalfEdgeTable
+        {
+            static constexpr u32 invalid = UINT32_MAX;
+
+            acul::vector<u32> offsets;          ///< Face ranges. Holds face count + 1 entries.
+            acul::vector<u32> faces;            ///< Face of every half-edge.
+            acul::vector<u32> twins;            ///< Opposite half-edge, `invalid` on boundary and non-manifold edges.
+            acul::vector<u32> edges;            ///< Undirected edge of every half-edge.
+            acul::vector<EdgeFlags> edge_flags; ///< Classification of every undirected edge.
+
+            size_t size() const { return faces.size(); }
+
+            size_t edge_count() const { return edge_flags.size(); }
+
+            u32 next(u32 half_edge) const
+            {
+                const u32 face = faces[half_edge];
+                return half_edge + 1 < offsets[face + 1] ? half_edge + 1 : offsets[face];
+            }
+
+            u32 prev(u32 half_edge) const
+            {
+                const u32 face = faces[half_edge];
+                return half_edge > offsets[face] ? half_edge - 1 : offsets[face + 1] - 1;
+            }
+        };
+
         // Represents a polygon face.
         struct Face
         {
@@ -316,6 +466,27 @@ namespace umbf
             u32 count;                        ///< Number of indices that define this face.
         };
 
+        /**
+         * @brief Flat (CSR) storage of model faces.
+         *
+         * Vertex references of all faces are kept in a single array. Face `i` owns the range
+         * `[offsets[i], offsets[i + 1])` of `refs`. Other face attributes are stored in parallel arrays.
+         */
+        struct FaceTable
+        {
+            acul::vector<VertexRef> refs;     ///< Vertex references of all faces.
+            acul::vector<u32> offsets;        ///< Face ranges in `refs`. Holds face count + 1 entries.
+            acul::vector<amal::vec3> normals; ///< Normal vector of every face.
+            acul::vector<u32> first_index;    ///< Starting index in the index buffer for every face.
+            acul::vector<u32> index_count;    ///< Number of indices that define every face.
+
+            size_t size() const { return normals.size(); }
+
+            u32 ref_count(size_t face) const { return offsets[face + 1] - offsets[face]; }
+
+            const VertexRef *face_refs(size_t face) const { return refs.data() + offsets[face]; }
+        };
+
         using AABB = acul::min_max<amal::vec3>;
 
         // Represents a 3D mesh model.
@@ -328,6 +499,85 @@ namespace umbf
             AABB aabb;                     ///< Axis-aligned bounding box that encloses the model.
         };
 
+        // Represents a 3D mesh model with flat face storage.
+        struct CompactModel
+        {
+            acul::vector<Vertex> vertices; ///< Array containing all vertices of the model.
+            u32 group_count;               ///< Size of the vertex group array.
+            FaceTable faces;               ///< Faces that make up the model.
+            acul::vector<u32> indices;     ///< Array of indices for rendering the model.
+            AABB aabb;                     ///< Axis-aligned bounding box that encloses the model.
+        };
+
+        /**
+         * @brief Index buffer stored with the narrowest index type that addresses all vertices.
+         *
+         * Used to hand `Model::indices` to consumers that benefit from 16-bit indices. Mesh blocks select the
+         * index width the same way when they are written.
+         */
+        class IndexBuffer
+        {
+        public:
+            /// Largest vertex count that can be addressed with 16-bit indices
+            static constexpr size_t max_16bit_vertices = 65536;
+
+            IndexBuffer() = default;
+
+            /// @brief Packs the indices, in parallel, to 16 bits if `vertex_count` allows it. Indices must be
+            /// smaller than `vertex_count`.
+            UMBF_EXPORT IndexBuffer(const acul::vector<u32> &indices, size_t vertex_count);
+
+            bool is_16bit() const { return _is_16bit; }
+
+            /// @brief Size of one index in bytes
+            u32 index_size() const { return _is_16bit ? sizeof(u16) : sizeof(u32); }
+
+            size_t size() const { return _is_16bit ? _indices16.size() : _indices32.size(); }
+
+            /// @brief Raw data with `index_size()` bytes per index
+            const void *data() const
+            {
+                return _is_16bit ? static_cast<const void *>(_indices16.data()) : _indices32.data();
+            }
+
+            u32 operator[](size_t index) const { return _is_16bit ? _indices16[index] : _indices32[index]; }
+
+            /// @brief Calls `f(u32)` for every index, branching on the index type once
+            template <typename F>
+            void for_each(F &&f) const
+            {
+                if (_is_16bit)
+                    for (u16 index : _indices16) f(static_cast<u32>(index));
+                else
+                    for (u32 index : _indices32) f(index);
+            }
+
+            /// @brief Widens the indices to 32 bits
+            UMBF_EXPORT void unpack(acul::vector<u32> &dst) const;
+
+            const acul::vector<u16> &indices16() const { return _indices16; }
+            const acul::vector<u32> &indices32() const { return _indices32; }
+
+        private:
+            acul::vector<u16> _indices16;
+            acul::vector<u32> _indices32;
+            bool _is_16bit = false;
+        };
+
+        // Storage encoding of the mesh block arrays.
+        struct EncodingBits
+        {
+            enum enum_type : u32
+            {
+                none = 0x0,
+                /// Positions quantized to 16 bits within the model bounds, octahedral 16-bit normals, half UVs.
+                /// Vertex, index and face streams are delta and group varint coded.
+                quantized = 0x1
+            };
+            using flag_bitmask = std::true_type;
+        };
+        using Encoding = acul::flags<EncodingBits>;
+
         struct Transform
         {
             amal::vec3 position = {0.0f, 0.0f, 0.0f};
@@ -338,8 +588,9 @@ namespace umbf
         // Represents a block of mesh data.
         struct Mesh : Block
         {
-            Model model;         ///< The 3D model data contained in this mesh block.
-            Transform transform; ///< Transformation information for the mesh.
+            Model model;                            ///< The 3D model data contained in this mesh block.
+            Transform transform;                    ///< Transformation information for the mesh.
+            Encoding encoding = EncodingBits::none; ///< Storage encoding used when the block is written.
 
             /**
              * @brief Returns the signature of the block.
@@ -347,8 +598,310 @@ namespace umbf
              */
             virtual u32 signature() const override { return sign_block::mesh; }
         };
+
+        /**
+         * @brief Mesh block backed by a `CompactModel`.
+         *
+         * Has its own signature so that consumers can tell it from `Mesh` without casts. The payload is shared
+         * with `Mesh`, so either stream reads either signature. Only `utils::object_bounds` and what is built on
+         * it, the scene index and scene partitioning, accept both block types. Instancing, draw range, tangent and
+         * LOD generation process `Mesh` blocks only, so keep `sign_block::mesh` registered to `streams::mesh` for
+         * scenes that go through them.
+         */
+        struct CompactMesh : Block
+        {
+            CompactModel model;                     ///< The 3D model data contained in this mesh block.
+            Transform transform;                    ///< Transformation information for the mesh.
+            Encoding encoding = EncodingBits::none; ///< Storage encoding used when the block is written.
+
+            /**
+             * @brief Returns the signature of the block.
+             * @return The signature of the block.
+             */
+            virtual u32 signature() const override { return sign_block::compact_mesh; }
+        };
+
+        /**
+         * @brief Reference to a `Mesh` block owned by another object of the same scene.
+         *
+         * Only the source id and the transform are serialized. The shared mesh is resolved when the scene
+         * block is read.
+         */
+        struct Instance : Block
+        {
+            u64 source;                  ///< Id of the object that owns the shared `Mesh` block.
+            Transform transform;         ///< Transform of this instance.
+            acul::shared_ptr<Mesh> mesh; ///< Shared mesh. Null if the source could not be resolved.
+
+            /**
+             * @brief Returns the signature of the block.
+             * @return The signature of the block.
+             */
+            virtual u32 signature() const override { return sign_block::mesh_instance; }
+        };
+
+        /**
+         * @brief Cluster of up to 64 vertices and 124 triangles.
+         *
+         * The cluster is back-facing for a camera at `eye` when
+         * `dot(center - eye, cone_axis) >= cone_cutoff * length(center - eye) + radius`.
+         */
+        struct Meshlet
+        {
+            u32 vertex_offset;    ///< Offset of the first entry in `Meshlets::vertices`.
+            u32 triangle_offset;  ///< Offset of the first entry in `Meshlets::triangles`.
+            u32 vertex_count;     ///< Number of unique vertices referenced by the meshlet.
+            u32 triangle_count;   ///< Number of triangles in the meshlet.
+            amal::vec3 center;    ///< Center of the bounding sphere.
+            f32 radius;           ///< Radius of the bounding sphere.
+            amal::vec3 cone_axis; ///< Average normal direction of the meshlet triangles.
+            f32 cone_cutoff;      ///< Sine of the cone spread. 1 disables cone culling.
+        };
+
+        /**
+         * @brief Meshlet descriptors of a mesh. Stored next to the `Mesh` block of the same object.
+         *
+         * Arrays are kept contiguous and can be uploaded to the GPU as is.
+         */
+        struct Meshlets : Block
+        {
+            acul::vector<Meshlet> meshlets; ///< Meshlet descriptors.
+            acul::vector<u32> vertices;     ///< Mesh vertex indices referenced by meshlets.
+            acul::vector<u8> triangles;     ///< Meshlet-local vertex indices, three per triangle.
+
+            /**
+             * @brief Returns the signature of the block.
+             * @return The signature of the block.
+             */
+            virtual u32 signature() const override { return sign_block::meshlets; }
+        };
+
+        // Level of detail inside `LodChain`
+        struct LodLevel
+        {
+            u32 first_index; ///< Offset of the first index in `LodChain::indices`.
+            u32 index_count; ///< Number of indices. The level is a triangle list.
+            f32 error;       ///< Simplification error relative to the model extent.
+        };
+
+        /**
+         * @brief Levels of detail of a mesh. Stored next to the `Mesh` block of the same object.
+         *
+         * All levels index the vertex buffer of the mesh. Level 0 is the source triangle list.
+         */
+        struct LodChain : Block
+        {
+            acul::vector<LodLevel> levels; ///< Levels ordered from the finest to the coarsest.
+            acul::vector<u32> indices;     ///< Index ranges of all levels.
+
+            /**
+             * @brief Returns the signature of the block.
+             * @return The signature of the block.
+             */
+            virtual u32 signature() const override { return sign_block::lod_chain; }
+        };
+
+        struct VertexAttribute
+        {
+            enum enum_type : u8
+            {
+                tangent, ///< Tangent with the bitangent sign in `w`
+                color,   ///< Vertex color
+                uv1,     ///< Second texture coordinate set
+                custom   ///< Application-defined data
+            };
+        };
+
+        // Storage format of a vertex attribute
+        struct VertexFormat
+        {
+            enum enum_type : u8
+            {
+                f32x1,
+                f32x2,
+                f32x3,
+                f32x4,
+                f16x2,
+                f16x4,
+                unorm8x4,
+                count
+            };
+        };
+
+        /// @brief Returns the size of a vertex format in bytes or 0 for an unknown format
+        inline u32 vertex_format_size(VertexFormat::enum_type format)
+        {
+            switch (format)
+            {
+                case VertexFormat::f32x1:
+                case VertexFormat::f16x2:
+                case VertexFormat::unorm8x4:
+                    return 4;
+                case VertexFormat::f32x2:
+                case VertexFormat::f16x4:
+                    return 8;
+                case VertexFormat::f32x3:
+                    return 12;
+                case VertexFormat::f32x4:
+                    return 16;
+                default:
+                    return 0;
+            }
+        }
+
+        // Attribute inside a vertex stream
+        struct VertexElement
+        {
+            VertexAttribute::enum_type attribute;
+            VertexFormat::enum_type format;
+            u16 offset; ///< Byte offset inside the stride of the stream.
+        };
+
+        // Buffer of per-vertex data. A stream with several elements is interleaved.
+        struct VertexStream
+        {
+            acul::vector<VertexElement> elements; ///< Layout of one vertex.
+            u32 stride = 0;                        ///< Bytes per vertex.
+            acul::vector<u8> data;                 ///< `stride` bytes per vertex.
+        };
+
+        /**
+         * @brief Additional vertex attributes of a mesh. Stored next to the `Mesh` block of the same object.
+         *
+         * Vertex `i` of every stream belongs to vertex `i` of the model. Only attributes present in the asset
+         * are stored, each in its own format. Utilities that reorder or weld model vertices do not update this
+         * block.
+         */
+        struct VertexAttributes : Block
+        {
+            u32 vertex_count = 0;               ///< Number of vertices in every stream.
+            acul::vector<VertexStream> streams; ///< Separate or interleaved streams.
+
+            /**
+             * @brief Finds the stream that holds an attribute.
+             * @param attribute Attribute to look for.
+             * @param element Receives the element of the attribute. Optional.
+             * @return Pointer to the stream or nullptr if the attribute is missing.
+             */
+            UMBF_EXPORT const VertexStream *find(VertexAttribute::enum_type attribute,
+                                                 const VertexElement **element = nullptr) const;
+
+            /**
+             * @brief Returns the signature of the block.
+             * @return The signature of the block.
+             */
+            virtual u32 signature() const override { return sign_block::vertex_attributes; }
+        };
+
+        // Contiguous range of the index buffer drawn with one material
+        struct DrawRange
+        {
+            u64 mat_id;      ///< Material of the range.
+            u32 first_index; ///< Offset of the first index in `Model::indices`.
+            u32 index_count; ///< Number of indices.
+        };
+
+        /**
+         * @brief Per-material draw ranges of a mesh. Stored next to the `Mesh` block of the same object.
+         *
+         * Valid for models whose index buffer was grouped with utils::mesh::build_draw_ranges().
+         */
+        struct DrawRanges : Block
+        {
+            acul::vector<DrawRange> ranges; ///< Ranges in index buffer order.
+
+            /**
+             * @brief Returns the signature of the block.
+             * @return The signature of the block.
+             */
+            virtual u32 signature() const override { return sign_block::draw_ranges; }
+        };
+
+        // Node of a flattened bounding volume hierarchy
+        struct BvhNode
+        {
+            amal::vec3 min; ///< Minimum corner of the node bounds.
+            u32 first;      ///< Index of the left child for inner nodes, first primitive slot for leaves.
+            amal::vec3 max; ///< Maximum corner of the node bounds.
+            u32 count;      ///< Number of primitives of a leaf. Zero for inner nodes.
+
+            bool is_leaf() const { return count != 0; }
+        };
+
+        /**
+         * @brief Bounding volume hierarchy over mesh triangles. Stored next to the `Mesh` block of the same object.
+         *
+         * Node 0 is the root. Children of an inner node are stored next to each other at `first` and `first + 1`.
+         * Triangle `t` covers `indices[t * 3]` to `indices[t * 3 + 2]` of the model.
+         */
+        struct Bvh : Block
+        {
+            acul::vector<BvhNode> nodes;  ///< Flattened nodes in depth-first order.
+            acul::vector<u32> primitives; ///< Triangle indices referenced by leaves.
+
+            /**
+             * @brief Returns the signature of the block.
+             * @return The signature of the block.
+             */
+            virtual u32 signature() const override { return sign_block::bvh; }
+        };
     } // namespace mesh
 
+    /**
+     * @brief Spatial index over the objects of a scene.
+     *
+     * Built from the world bounds of every object that has a mesh block. Optional, stored next to the `Scene`
+     * block. Slot `i` of `ids` and `bounds` describes one object, leaves of the hierarchy reference slots.
+     */
+    struct SceneIndex : Block
+    {
+        acul::vector<mesh::BvhNode> nodes; ///< Flattened nodes, see `mesh::Bvh`.
+        acul::vector<u32> primitives;      ///< Object slots referenced by leaves.
+        acul::vector<u64> ids;             ///< Object id of each slot.
+        acul::vector<mesh::AABB> bounds;   ///< World bounds of each slot.
+        f32 build_cost = 0.0f;             ///< SAH cost after the last full build, used to detect degraded refits.
+
+        /**
+         * @brief Returns the signature of the block.
+         * @return The signature of the block.
+         */
+        virtual u32 signature() const override { return sign_block::scene_index; }
+    };
+
+    // Chunk of a partitioned scene file. Offsets are relative to the mapped payload.
+    struct SceneCell
+    {
+        mesh::AABB bounds; ///< Union of the world bounds of the cell objects.
+        u64 offset;        ///< Offset of the chunk in the mapped payload.
+        u64 size;          ///< Stored size of the chunk.
+        u64 raw_size;      ///< Decoded size of the chunk, used for memory budgeting.
+        u32 object_count;  ///< Number of objects stored in the chunk.
+        u32 reserved;
+    };
+
+    /**
+     * @brief Index of a partitioned scene file.
+     *
+     * Objects are grouped by the grid cell containing the center of their world bounds. Every cell is a
+     * separately compressed `Scene` chunk. Textures, materials and objects without bounds are kept in the
+     * shared chunk. A cell with instances depends on the cells that hold their sources, dependencies of cell
+     * `i` are `dependencies[dependency_offsets[i], dependency_offsets[i + 1])`.
+     */
+    struct SceneCells : Block
+    {
+        f32 cell_size = 0.0f;                 ///< Edge length of the grid cells.
+        SceneCell shared;                     ///< Chunk that stays resident while the file is open.
+        acul::vector<SceneCell> cells;        ///< Spatial cells.
+        acul::vector<u32> dependency_offsets; ///< Dependency ranges, one per cell plus one.
+        acul::vector<u32> dependencies;       ///< Cells holding instance sources, sorted per cell.
+
+        /**
+         * @brief Returns the signature of the block.
+         * @return The signature of the block.
+         */
+        virtual u32 signature() const override { return sign_block::scene_cells; }
+    };
+
     // Represents material information as an asset block.
     struct MaterialInfo final : Block
     {
@@ -368,6 +921,47 @@ namespace umbf
         virtual u32 signature() const override { return sign_block::material_info; }
     };
 
+    /**
+     * @brief Set of face indices stored as sorted runs.
+     *
+     * Materials usually cover long contiguous face runs, so a run list is much smaller than the face list and
+     * answers membership queries with a binary search.
+     */
+    struct FaceSet
+    {
+        struct Run
+        {
+            u32 first; ///< First face of the run.
+            u32 count; ///< Number of faces in the run.
+        };
+
+        acul::vector<Run> runs; ///< Ascending, disjoint and non-adjacent runs.
+
+        FaceSet() = default;
+
+        /// @brief Builds the set from face indices in any order. Duplicates are ignored.
+        UMBF_EXPORT explicit FaceSet(const acul::vector<u32> &faces);
+
+        /// @brief Checks whether the set contains a face
+        UMBF_EXPORT bool contains(u32 face) const;
+
+        /// @brief Returns the number of faces in the set
+        UMBF_EXPORT u64 size() const;
+
+        /// @brief Returns the faces in `[0, face_count)` that are not in the set
+        UMBF_EXPORT FaceSet complement(u32 face_count) const;
+
+        /// @brief Appends the faces of the set in ascending order
+        UMBF_EXPORT void append_to(acul::vector<u32> &dst) const;
+
+        template <typename F>
+        void for_each(F &&f) const
+        {
+            for (const auto &run : runs)
+                for (u32 i = 0; i < run.count; ++i) f(run.first + i);
+        }
+    };
+
     /**
      * @brief Represents material range assignment attributes as an asset block.
      *
@@ -433,6 +1027,30 @@ namespace umbf
         UMBF_EXPORT const Node *get_node(const acul::path &path) const;
     };
 
+    /**
+     * @brief Writes a library tree with subtree sizes.
+     *
+     * Every node header ends with the byte size of its children or asset, so readers can skip a subtree
+     * without parsing it. Leaf assets are serialized in parallel.
+     */
+    UMBF_EXPORT void write_library_tree(acul::bin_stream &stream, const Library::Node &root);
+
+    /**
+     * @brief Reads a library tree written by write_library_tree().
+     *
+     * Node headers are walked first, then the leaf assets of all subtrees are parsed in parallel.
+     */
+    UMBF_EXPORT void read_library_tree(acul::bin_stream &stream, Library::Node &root);
+
+    /**
+     * @brief Reads a single node of a library tree, skipping all other subtrees.
+     * @param stream Stream positioned at the root node, i.e. at the payload of a `library` block.
+     * @param path Path of the node relative to the root.
+     * @param dst Destination node.
+     * @return False if the path is not found.
+     */
+    UMBF_EXPORT bool read_library_node(acul::bin_stream &stream, const acul::path &path, Library::Node &dst);
+
     // Meta block reserved for common external resourcees
     struct RawBlock : public Block
     {
@@ -454,6 +1072,14 @@ namespace umbf
         virtual u32 signature() const { return sign_block::mapping; }
     };
 
+    /// Entry of a mapped library stored in the index instead of the payload
+    struct InlineMapping : public Block
+    {
+        acul::vector<char> data; ///< Uncompressed serialized meta blocks of the entry.
+
+        virtual u32 signature() const { return sign_block::inline_mapping; }
+    };
+
     struct LibraryMapData
     {
         mutable FILE *fd = nullptr;
@@ -469,6 +1095,108 @@ namespace umbf
                                                          const acul::shared_ptr<Mapping> &node_mapping,
                                                          acul::vector<char> &dst);
 
+    /**
+     * @brief Loads the data of a leaf node of a mapped library.
+     *
+     * `InlineMapping` entries are copied from the index without any I/O, `Mapping` entries are read from the
+     * payload. Other blocks of the node are ignored. Mapped libraries written before `InlineMapping` existed
+     * stored inline entries as a `RawBlock` and must be written again with `save_library_mapped`.
+     * @param mapping Opened mapped library.
+     * @param node Leaf node of `mapping.library`.
+     * @param dst Serialized meta blocks of the asset.
+     */
+    UMBF_EXPORT acul::op_result load_library_mapped_data(const LibraryMapData &mapping, const Library::Node &node,
+                                                         acul::vector<char> &dst);
+
+    /**
+     * @brief Writes a library as a mapped file.
+     *
+     * The file holds the library tree as an index followed by a raw block with the payload. The meta blocks of
+     * every leaf asset are serialized and compressed in parallel. Entries up to `inline_size` bytes are kept
+     * uncompressed in the index as an `InlineMapping`, larger ones are stored in the payload and addressed by a
+     * `Mapping` block.
+     * @param library Source library.
+     * @param path Destination path.
+     * @param inline_size Largest serialized entry stored in the index. Zero disables inlining.
+     * @param compression Compression level of the payload entries.
+     * @return True if the file was written.
+     */
+    UMBF_EXPORT bool save_library_mapped(const Library &library, const acul::path &path, u64 inline_size = 256,
+                                         int compression = 5);
+
+    /**
+     * @brief Writes a scene as a partitioned file that can be streamed by cells.
+     *
+     * The file holds a `SceneCells` index followed by a raw block with the chunks. Chunks are serialized and
+     * compressed in parallel. Objects without bounds are stored in the shared chunk together with the sources
+     * of their `mesh::Instance` blocks. Other sources stay in their own cell, which is recorded as a dependency
+     * of every cell instancing it, so a streamer loads them on demand.
+     * @param scene Source scene.
+     * @param path Destination path.
+     * @param cell_size Edge length of the grid cells.
+     * @param compression Compression level of the chunks.
+     * @return True if the file was written.
+     */
+    UMBF_EXPORT bool save_scene_partitioned(const Scene &scene, const acul::path &path, f32 cell_size,
+                                            int compression = 5);
+
+    /**
+     * @brief Loads and unloads cells of a partitioned scene file around a position.
+     *
+     * Cells are selected by distance to their bounds, nearest first, until the sum of their decoded sizes
+     * would exceed the memory budget. A cell is loaded together with the cells holding its instance sources,
+     * and all of them are counted against the budget. The shared chunk is loaded on open and is not counted
+     * against the budget, it only holds objects without bounds and their sources. Instances are resolved
+     * against all resident cells.
+     */
+    class SceneStreamer
+    {
+    public:
+        SceneStreamer() = default;
+        SceneStreamer(const SceneStreamer &) = delete;
+        SceneStreamer &operator=(const SceneStreamer &) = delete;
+        ~SceneStreamer() { close(); }
+
+        UMBF_EXPORT acul::op_result open(const acul::path &path);
+        UMBF_EXPORT void close();
+
+        /**
+         * @brief Updates the set of resident cells.
+         * @param position Streaming center.
+         * @param radius Cells farther than the radius are unloaded.
+         * @return The result of the operation. Cells that failed to load stay unloaded.
+         */
+        UMBF_EXPORT acul::op_result update(const amal::vec3 &position, f32 radius);
+
+        u64 memory_budget() const { return _budget; }
+        void memory_budget(u64 bytes) { _budget = bytes; }
+
+        /// @brief Sum of the decoded sizes of the resident cells
+        u64 resident_size() const { return _resident_size; }
+
+        const acul::shared_ptr<SceneCells> &index() const { return _index; }
+        const acul::shared_ptr<Scene> &shared() const { return _shared; }
+
+        /// @brief Returns the chunk of a cell or null if the cell is not resident
+        const acul::shared_ptr<Scene> &cell(u32 index) const { return _cells[index]; }
+
+        const acul::vector<u32> &resident_cells() const { return _resident; }
+
+    private:
+        FILE *_fd = nullptr;
+        u64 _payload_offset = 0;
+        u64 _payload_size = 0;
+        bool _compressed = true;
+        u64 _budget = 256ULL << 20;
+        u64 _resident_size = 0;
+        acul::shared_ptr<SceneCells> _index;
+        acul::shared_ptr<Scene> _shared;
+        acul::vector<acul::shared_ptr<Scene>> _cells;
+        acul::vector<u32> _resident;
+
+        void resolve_resident_instances();
+    };
+
     /**
      * Class responsible for managing asset libraries.
      *
@@ -547,12 +1275,26 @@ namespace umbf
         extern UMBF_EXPORT const Stream material;
         extern UMBF_EXPORT const Stream material_info;
         extern UMBF_EXPORT const Stream material_range;
+        extern UMBF_EXPORT const Stream material_range_v1;
         extern UMBF_EXPORT const Stream scene;
+        extern UMBF_EXPORT const Stream scene_v1;
         extern UMBF_EXPORT const Stream mesh;
+        extern UMBF_EXPORT const Stream mesh_v1;
+        extern UMBF_EXPORT const Stream compact_mesh;
+        extern UMBF_EXPORT const Stream mesh_instance;
+        extern UMBF_EXPORT const Stream meshlets;
+        extern UMBF_EXPORT const Stream lod_chain;
+        extern UMBF_EXPORT const Stream draw_ranges;
+        extern UMBF_EXPORT const Stream vertex_attributes;
+        extern UMBF_EXPORT const Stream bvh;
+        extern UMBF_EXPORT const Stream scene_index;
+        extern UMBF_EXPORT const Stream scene_cells;
         extern UMBF_EXPORT const Stream target;
         extern UMBF_EXPORT const Stream library;
+        extern UMBF_EXPORT const Stream library_v1;
         extern UMBF_EXPORT const Stream raw_block;
         extern UMBF_EXPORT const Stream mapping_block;
+        extern UMBF_EXPORT const Stream inline_mapping_block;
     } // namespace streams
 
     UMBF_EXPORT void insert_default_streams(streams::HashResolver &resolver);
@@ -607,13 +1349,9 @@ namespace acul
         return read(dst.header).read(dst.blocks);
     }
 
+    // Stores a 16-bit count. Throws acul::runtime_error if the array does not fit.
     template <>
-    inline bin_stream &bin_stream::write(const vector<umbf::File> &assets)
-    {
-        write(static_cast<u16>(assets.size()));
-        for (auto &asset : assets) write(asset);
-        return *this;
-    }
+    UMBF_EXPORT bin_stream &bin_stream::write(const vector<umbf::File> &assets);
 
     template <>
     bin_stream &bin_stream::read(vector<umbf::File> &dst);
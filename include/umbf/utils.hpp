@@ -2,6 +2,7 @@
 
 #include <acul/enum.hpp>
 #include <amal/rect.hpp>
+#include <limits>
 #include "umbf.hpp"
 
 namespace umbf::utils
@@ -72,8 +73,406 @@ namespace umbf::utils
     {
         using namespace umbf::mesh;
         UMBF_EXPORT void fill_vertex_groups(const Model &model, acul::vector<VertexGroup> &groups);
+
+        /**
+         * @brief Builds the vertex group adjacency of a model.
+         *
+         * Runs a parallel counting pass over faces, a prefix sum over groups and a parallel scatter pass.
+         * The order of references inside each group matches the order of faces.
+         */
+        UMBF_EXPORT void fill_vertex_groups(const Model &model, VertexGroupTable &table);
+        UMBF_EXPORT void fill_vertex_groups(const CompactModel &model, VertexGroupTable &table);
+
+        /// @brief Expands compact vertex group adjacency into per-group storage
+        UMBF_EXPORT void expand_vertex_groups(const VertexGroupTable &table, acul::vector<VertexGroup> &groups);
+
+        /**
+         * @brief Builds the half-edge adjacency of a model.
+         *
+         * Edge keys are generated in parallel over faces, sorted with a parallel sort and matched by scanning
+         * runs of equal keys, so no hashing is involved and the result does not depend on scheduling.
+         * Undirected edges are numbered in key order.
+         */
+        UMBF_EXPORT void build_half_edges(const Model &model, HalfEdgeTable &table);
+        UMBF_EXPORT void build_half_edges(const CompactModel &model, HalfEdgeTable &table);
+
+        // Post-transform vertex cache efficiency of an index buffer
+        struct CacheStats
+        {
+            f32 acmr = 0.0f; ///< Average cache miss ratio. Transformed vertices per triangle.
+            f32 atvr = 0.0f; ///< Average transformed vertex ratio. Transformed vertices per referenced vertex.
+        };
+
+        struct VertexCacheReport
+        {
+            CacheStats before;
+            CacheStats after;
+        };
+
+        /**
+         * @brief Simulates a FIFO post-transform vertex cache over a triangle index buffer.
+         * @param indices Triangle list indices.
+         * @param vertex_count Size of the vertex buffer.
+         * @param cache_size Number of cache entries.
+         */
+        UMBF_EXPORT CacheStats analyze_vertex_cache(const acul::vector<u32> &indices, size_t vertex_count,
+                                                    u32 cache_size = 16);
+
+        /**
+         * @brief Reorders the index buffer for vertex cache locality and the vertex buffer for fetch locality.
+         *
+         * Faces are reordered as whole units with the Tipsify algorithm, so the order of `faces`
+         * (and the face indices stored in `MaterialRange` blocks) is kept, only their index ranges move.
+         * Models without faces are processed per triangle. Vertices are then sorted by first use and
+         * `indices` and `VertexRef`s are remapped. Intended to run once before saving.
+         * @return Cache efficiency before and after the optimization.
+         */
+        UMBF_EXPORT VertexCacheReport optimize_vertex_cache(Model &model, u32 cache_size = 16);
+        UMBF_EXPORT VertexCacheReport optimize_vertex_cache(CompactModel &model, u32 cache_size = 16);
+
+        /// @brief Computes the bounding box of vertex positions with a parallel min/max reduction
+        UMBF_EXPORT AABB compute_aabb(const acul::vector<Vertex> &vertices);
+
+        inline void recompute_aabb(Model &model) { model.aabb = compute_aabb(model.vertices); }
+
+        inline void recompute_aabb(CompactModel &model) { model.aabb = compute_aabb(model.vertices); }
+
+        struct NormalWeighting
+        {
+            enum enum_type : u8
+            {
+                area, ///< Face normals are weighted by face area
+                angle ///< Face normals are weighted by the corner angle at the vertex
+            };
+        };
+
+        /// @brief Recomputes face normals in parallel with Newell's method, so non-planar polygons are supported
+        UMBF_EXPORT void recompute_face_normals(Model &model);
+        UMBF_EXPORT void recompute_face_normals(CompactModel &model);
+
+        /**
+         * @brief Recomputes face and vertex normals in parallel.
+         *
+         * Every vertex gathers the normals of its faces through the vertex group adjacency, so each vertex
+         * is written by a single task. Vertices not referenced by any face keep their normals.
+         * @param model Model to update.
+         * @param groups Vertex group adjacency of the model, see fill_vertex_groups().
+         * @param weighting Weighting of face normals.
+         */
+        UMBF_EXPORT void recompute_normals(Model &model, const VertexGroupTable &groups,
+                                           NormalWeighting::enum_type weighting = NormalWeighting::area);
+        UMBF_EXPORT void recompute_normals(CompactModel &model, const VertexGroupTable &groups,
+                                           NormalWeighting::enum_type weighting = NormalWeighting::area);
+
+        /// @brief Builds the vertex group adjacency and recomputes face and vertex normals
+        template <typename T>
+        inline void recompute_normals(T &model, NormalWeighting::enum_type weighting = NormalWeighting::area)
+        {
+            VertexGroupTable groups;
+            fill_vertex_groups(model, groups);
+            recompute_normals(model, groups, weighting);
+        }
+
+        /**
+         * @brief Splits the triangle list of a model into meshlets.
+         *
+         * The index buffer is cut into chunks that are clustered in parallel. Triangles are packed greedily
+         * in index order, so running optimize_vertex_cache() first improves meshlet fill. Bounding spheres
+         * and normal cones are computed in parallel per meshlet.
+         * @param model Source model. `indices` must hold a triangle list.
+         * @param dst Destination block.
+         * @param max_vertices Vertex limit of a meshlet, from 3 to 256.
+         * @param max_triangles Triangle limit of a meshlet, at least 1.
+         * @throws acul::runtime_error if a limit is out of range.
+         */
+        UMBF_EXPORT void build_meshlets(const Model &model, Meshlets &dst, u32 max_vertices = 64,
+                                        u32 max_triangles = 124);
+        UMBF_EXPORT void build_meshlets(const CompactModel &model, Meshlets &dst, u32 max_vertices = 64,
+                                        u32 max_triangles = 124);
+
+        struct LodOptions
+        {
+            u32 max_levels = 4;    ///< Number of levels including the source level.
+            f32 reduction = 0.5f;  ///< Target triangle ratio between consecutive levels.
+            f32 max_error = 0.02f; ///< Error limit relative to the model extent.
+        };
+
+        /**
+         * @brief Builds a LOD chain with quadric error edge collapses.
+         *
+         * Vertices are collapsed onto their neighbours, so all levels share the vertex buffer of the model.
+         * Vertices on UV/normal seams, open borders and material boundaries are locked.
+         * Each level is simplified from the previous one.
+         * @param model Source model. `indices` must hold a triangle list.
+         * @param materials Material assignments of model faces.
+         * @param dst Destination block.
+         * @param options LOD options.
+         */
+        UMBF_EXPORT void build_lod_chain(const Model &model,
+                                         const acul::vector<acul::shared_ptr<MaterialRange>> &materials,
+                                         LodChain &dst, const LodOptions &options = {});
+
+        /**
+         * @brief Builds LOD chains for all meshes of a scene in parallel.
+         *
+         * The chain of every object with a `Mesh` block is stored in a `LodChain` block of the same object,
+         * replacing an existing one. `MaterialRange` blocks of the object are respected.
+         */
+        UMBF_EXPORT void build_lod_chains(Scene &scene, const LodOptions &options = {});
+
+        /**
+         * @brief Groups the index buffer of a model by material so every material is drawn with one range.
+         *
+         * Faces keep their order, only `Face::first_vertex` is updated, so face indices of material assignments
+         * stay valid. Indices of one material follow face order. Faces without an assignment are drawn with
+         * `default_id`, a face listed by several assignments belongs to the last one, assignments with equal
+         * material ids share a range. Computed with a parallel counting sort over face chunks.
+         * Triangle order changes, so meshlets, LOD chains and BVHs must be built afterwards.
+         * @param model Model whose faces cover every index exactly once.
+         * @param materials Material assignments of model faces.
+         * @param default_id Material of unassigned faces.
+         * @param dst Destination block. The default range comes first, then materials in assignment order.
+         * @return False if the faces do not cover the index buffer. The model is left unchanged.
+         */
+        UMBF_EXPORT bool build_draw_ranges(Model &model,
+                                           const acul::vector<acul::shared_ptr<MaterialRange>> &materials,
+                                           u64 default_id, DrawRanges &dst);
+
+        /**
+         * @brief Builds draw ranges for all meshes of a scene in parallel.
+         *
+         * The ranges of every object with a `Mesh` block are stored in a `DrawRanges` block of the same object,
+         * replacing an existing one. A mesh block shared by several objects or by instances is processed once and
+         * its ranges are stored in all of them. `Meshlets`, `LodChain` and `Bvh` blocks of these objects reference
+         * the old triangle order and are removed.
+         * @return Number of meshes that could not be grouped.
+         */
+        UMBF_EXPORT u32 build_draw_ranges(Scene &scene, u64 default_id);
+
+        /**
+         * @brief Builds a binned SAH BVH over primitive bounds.
+         *
+         * Subtrees are built in parallel. The result does not depend on the thread count.
+         * @param bounds Bounds of each primitive.
+         * @param nodes Destination nodes.
+         * @param primitives Destination primitive slots referenced by leaves.
+         */
+        UMBF_EXPORT void build_bvh(const acul::vector<AABB> &bounds, acul::vector<BvhNode> &nodes,
+                                   acul::vector<u32> &primitives);
+
+        /// @brief Builds a BVH over the triangles of a model
+        UMBF_EXPORT void build_bvh(const Model &model, Bvh &dst);
+        UMBF_EXPORT void build_bvh(const CompactModel &model, Bvh &dst);
+
+        /**
+         * @brief Transforms a box and returns the bounds of the result.
+         *
+         * Rotation is given by Euler angles in radians, applied around X, then Y, then Z.
+         */
+        UMBF_EXPORT AABB transform_aabb(const AABB &box, const Transform &transform);
+
+        struct Ray
+        {
+            amal::vec3 origin;                                ///< Ray origin.
+            amal::vec3 direction;                             ///< Ray direction, not required to be normalized.
+            f32 t_min = 0.0f;                                 ///< Start of the ray interval.
+            f32 t_max = std::numeric_limits<f32>::infinity(); ///< End of the ray interval.
+        };
+
+        struct RayHit
+        {
+            u32 triangle = UINT32_MAX; ///< Index of the hit triangle.
+            f32 t = 0.0f;              ///< Ray parameter of the hit.
+            f32 u = 0.0f;              ///< Barycentric coordinate of the second triangle vertex.
+            f32 v = 0.0f;              ///< Barycentric coordinate of the third triangle vertex.
+        };
+
+        /**
+         * @brief Finds the closest triangle hit along a ray.
+         *
+         * Primitives past the index buffer of `model` are skipped, so a BVH that was built for another version
+         * of the model never reads out of bounds. Queries below follow the same rule.
+         * @return True if a triangle was hit within `[ray.t_min, ray.t_max]`.
+         */
+        UMBF_EXPORT bool intersect_ray(const Bvh &bvh, const Model &model, const Ray &ray, RayHit &hit);
+        UMBF_EXPORT bool intersect_ray(const Bvh &bvh, const CompactModel &model, const Ray &ray, RayHit &hit);
+
+        /**
+         * @brief Collects primitives whose leaf bounds and own bounds overlap a box.
+         * @param nodes Nodes of the hierarchy.
+         * @param primitives Primitive slots of the hierarchy.
+         * @param bounds Bounds of each primitive, as passed to build_bvh().
+         * @param box Query box.
+         * @param dst Receives primitive indices.
+         */
+        UMBF_EXPORT void query_aabb(const acul::vector<BvhNode> &nodes, const acul::vector<u32> &primitives,
+                                    const acul::vector<AABB> &bounds, const AABB &box, acul::vector<u32> &dst);
+
+        /// @brief Collects triangles whose bounds overlap a box
+        UMBF_EXPORT void query_aabb(const Bvh &bvh, const Model &model, const AABB &box, acul::vector<u32> &dst);
+        UMBF_EXPORT void query_aabb(const Bvh &bvh, const CompactModel &model, const AABB &box,
+                                    acul::vector<u32> &dst);
+
+        struct WeldMode
+        {
+            enum enum_type : u8
+            {
+                exact,    ///< Vertices are merged when all attributes are equal
+                quantized ///< Vertices are merged when attributes snap to the same grid cell
+            };
+        };
+
+        struct WeldOptions
+        {
+            WeldMode::enum_type mode = WeldMode::exact;
+            f32 position_epsilon = 1e-5f; ///< Grid step of positions in the quantized mode.
+            f32 uv_epsilon = 1e-5f;       ///< Grid step of UV coordinates in the quantized mode.
+            f32 normal_epsilon = 1e-3f;   ///< Grid step of normal components in the quantized mode.
+        };
+
+        /**
+         * @brief Builds an indexed model from triangle soup.
+         *
+         * Vertices are hashed in parallel and distributed over partitions, every partition is deduplicated
+         * in its own open-addressing table. Unique vertices keep the order of their first occurrence.
+         * Vertex groups are formed by welding positions with the same options.
+         * Every triangle becomes a face.
+         * @param soup Three vertices per triangle.
+         * @param dst Destination model.
+         * @param options Welding options.
+         */
+        UMBF_EXPORT void weld_triangle_soup(const acul::vector<Vertex> &soup, Model &dst,
+                                            const WeldOptions &options = {});
+
+        /**
+         * @brief Removes duplicate vertices of an indexed model and remaps indices and `VertexRef`s.
+         * @return Number of vertices left.
+         */
+        UMBF_EXPORT u32 weld_vertices(Model &model, const WeldOptions &options = {});
+
+        /**
+         * @brief Replaces duplicate meshes of a scene with instances of a single shared mesh.
+         *
+         * Models are hashed in parallel and candidates with equal hashes are compared byte by byte.
+         * The first object of every distinct model keeps its `Mesh` block, every later object with the same
+         * model and encoding gets a `mesh::Instance` that references it and keeps its own transform.
+         * Intended to run before the scene is written. Object ids must be unique.
+         * @return Number of meshes replaced by instances.
+         */
+        UMBF_EXPORT u32 instance_meshes(Scene &scene);
+
+        /**
+         * @brief Appends a separate stream with one attribute.
+         *
+         * Values are converted to the storage format in parallel. Missing components are dropped.
+         * @return False if the attribute already exists, the format is unknown or the value count differs
+         * from the vertex count of the block. The vertex count of an empty block is taken from `values`.
+         */
+        UMBF_EXPORT bool add_vertex_stream(VertexAttributes &dst, VertexAttribute::enum_type attribute,
+                                           VertexFormat::enum_type format, const acul::vector<amal::vec4> &values);
+
+        /**
+         * @brief Decodes an attribute to 32-bit floats in parallel.
+         *
+         * Components missing in the storage format are set to `(0, 0, 0, 1)`.
+         * @return False if the attribute is missing.
+         */
+        UMBF_EXPORT bool read_vertex_attribute(const VertexAttributes &src, VertexAttribute::enum_type attribute,
+                                               acul::vector<amal::vec4> &dst);
+
+        /// @brief Merges all streams into one interleaved stream, keeping element order
+        UMBF_EXPORT void interleave_vertex_streams(VertexAttributes &attributes);
+
+        /**
+         * @brief Generates per-vertex tangents.
+         *
+         * Triangle tangents are derived from positions and UVs in parallel over faces. As in MikkTSpace, every
+         * corner projects the tangent onto the plane of its vertex normal and weights it by the corner angle, the
+         * sum is orthogonalized against the normal again. Results are close to, but not bit-exact with, MikkTSpace.
+         * The sign of `w` is the UV handedness of the faces.
+         * A vertex shared by faces of opposite handedness is split: the mirrored faces get a copy of the vertex,
+         * their indices and `VertexRef`s are remapped and the other streams of `attributes` are extended.
+         * Vertex ids change, so meshlets, LOD chains and BVHs must be built afterwards.
+         * @param model Model with triangulated faces.
+         * @param attributes Destination block. An existing tangent element is overwritten in its own format,
+         * otherwise a stream with `format` is added.
+         * @param format Storage format of a new tangent stream. Must have four components.
+         * @return False if the faces are not triangulated, the format has less than four components or the
+         * streams of `attributes` do not match the vertex count.
+         */
+        UMBF_EXPORT bool generate_tangents(Model &model, VertexAttributes &attributes,
+                                           VertexFormat::enum_type format = VertexFormat::f32x4);
+
+        /**
+         * @brief Generates tangents for all meshes of a scene in parallel.
+         *
+         * Tangents are stored in the `VertexAttributes` block of every object with a `Mesh` block, the block is
+         * created if missing. A mesh block shared by several objects or by instances is processed once and all of
+         * them get the attribute block of the first object holding the mesh. When vertices are split, `Meshlets`
+         * and `LodChain` blocks of these objects reference the old vertex ids and are removed.
+         * @return Number of meshes that could not be processed.
+         */
+        UMBF_EXPORT u32 generate_tangents(Scene &scene, VertexFormat::enum_type format = VertexFormat::f32x4);
+
+        /// @brief Packs per-face vertex references and attributes into a flat face table
+        UMBF_EXPORT void fill_face_table(const acul::vector<Face> &faces, FaceTable &dst);
+
+        /// @brief Expands a flat face table into per-face storage
+        UMBF_EXPORT void expand_face_table(const FaceTable &src, acul::vector<Face> &dst);
+
+        /// @brief Converts a model to the flat face representation
+        UMBF_EXPORT void to_compact_model(const Model &src, CompactModel &dst);
+
+        /// @brief Converts a model with flat face storage back to per-face storage
+        UMBF_EXPORT void to_model(const CompactModel &src, Model &dst);
     } // namespace mesh
 
+    // The inside half-space of a plane satisfies `dot(normal, p) + distance >= 0`
+    struct Plane
+    {
+        amal::vec3 normal;
+        f32 distance;
+    };
+
+    struct Frustum
+    {
+        Plane planes[6];
+    };
+
+    /**
+     * @brief Computes the world bounds of an object.
+     *
+     * The first `Mesh`, `CompactMesh` or resolved `mesh::Instance` block of the object is used.
+     * @return False if the object has no such block.
+     */
+    UMBF_EXPORT bool object_bounds(const Object &object, mesh::AABB &dst);
+
+    /**
+     * @brief Builds the spatial index of scene objects.
+     *
+     * Every object with bounds, see object_bounds(), contributes the model bounds transformed by the mesh
+     * transform. Bounds are computed in parallel and the hierarchy is built with mesh::build_bvh().
+     */
+    UMBF_EXPORT void build_scene_index(const Scene &scene, SceneIndex &dst);
+
+    /**
+     * @brief Updates the spatial index after scene edits.
+     *
+     * If the indexed objects are unchanged, nodes are refitted to the new bounds. The index is rebuilt when
+     * objects were added or removed, or when refitting degraded the tree too much.
+     * @return True if the index was rebuilt.
+     */
+    UMBF_EXPORT bool update_scene_index(const Scene &scene, SceneIndex &index);
+
+    /// @brief Collects ids of objects whose bounds intersect a frustum
+    UMBF_EXPORT void query_frustum(const SceneIndex &index, const Frustum &frustum, acul::vector<u64> &ids);
+
+    /// @brief Collects ids of objects whose bounds overlap a box
+    UMBF_EXPORT void query_aabb(const SceneIndex &index, const mesh::AABB &box, acul::vector<u64> &ids);
+
+    /// @brief Collects ids of objects whose bounds are hit by a ray
+    UMBF_EXPORT void query_ray(const SceneIndex &index, const mesh::Ray &ray, acul::vector<u64> &ids);
+
     struct SkylineHeuristic
     {
         enum enum_type : u8
@@ -0,0 +1,599 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/parallel_invoke.h>
+#include <umbf/utils.hpp>
+
+namespace umbf
+{
+    namespace utils
+    {
+        namespace mesh
+        {
+            namespace
+            {
+                constexpr u32 g_bvh_bins = 16;
+                constexpr u32 g_bvh_min_leaf_size = 2;  // Ranges of this size always become leaves
+                constexpr u32 g_bvh_max_leaf_size = 8;  // Ranges above this size are always split
+                constexpr u32 g_bvh_parallel_size = 4096;
+
+                inline AABB empty_aabb()
+                {
+                    constexpr f32 inf = std::numeric_limits<f32>::infinity();
+                    return {amal::vec3(inf), amal::vec3(-inf)};
+                }
+
+                inline void grow(AABB &dst, const AABB &src)
+                {
+                    dst.min = amal::min(dst.min, src.min);
+                    dst.max = amal::max(dst.max, src.max);
+                }
+
+                inline void grow(AABB &dst, const amal::vec3 &point)
+                {
+                    dst.min = amal::min(dst.min, point);
+                    dst.max = amal::max(dst.max, point);
+                }
+
+                inline f32 half_area(const AABB &box)
+                {
+                    const amal::vec3 d = box.max - box.min;
+                    if (d.x < 0.0f || d.y < 0.0f || d.z < 0.0f) return 0.0f;
+                    return d.x * d.y + d.y * d.z + d.z * d.x;
+                }
+
+                inline bool overlaps(const AABB &a, const AABB &b)
+                {
+                    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y &&
+                           a.min.z <= b.max.z && a.max.z >= b.min.z;
+                }
+
+                struct BuildNode
+                {
+                    AABB bounds;
+                    u32 first;
+                    u32 count;
+                };
+
+                // Top-down binned SAH builder. Nodes are allocated by an atomic counter and flattened afterwards,
+                // so the final layout does not depend on the scheduling.
+                struct BvhBuilder
+                {
+                    const acul::vector<AABB> &bounds;
+                    acul::vector<amal::vec3> centroids;
+                    acul::vector<u32> &primitives;
+                    acul::vector<BuildNode> nodes;
+                    std::atomic<u32> node_count{1};
+
+                    BvhBuilder(const acul::vector<AABB> &bounds, acul::vector<u32> &primitives)
+                        : bounds(bounds), primitives(primitives)
+                    {
+                    }
+
+                    u32 find_bin(const amal::vec3 &centroid, int axis, f32 min, f32 scale) const
+                    {
+                        const f32 bin = (centroid[axis] - min) * scale;
+                        return bin <= 0.0f ? 0 : amal::min(g_bvh_bins - 1, static_cast<u32>(bin));
+                    }
+
+                    void build(u32 node, u32 first, u32 count)
+                    {
+                        AABB box = empty_aabb(), centroid_box = empty_aabb();
+                        for (u32 i = first; i < first + count; ++i)
+                        {
+                            grow(box, bounds[primitives[i]]);
+                            grow(centroid_box, centroids[primitives[i]]);
+                        }
+                        nodes[node] = {box, first, count};
+                        if (count <= g_bvh_min_leaf_size) return;
+
+                        // Evaluate bin boundaries of every axis
+                        f32 best_cost = std::numeric_limits<f32>::infinity();
+                        int best_axis = -1;
+                        u32 best_bin = 0;
+                        const amal::vec3 extent = centroid_box.max - centroid_box.min;
+                        for (int axis = 0; axis < 3; ++axis)
+                        {
+                            if (extent[axis] <= 0.0f) continue;
+                            const f32 scale = g_bvh_bins / extent[axis];
+                            AABB bin_bounds[g_bvh_bins];
+                            u32 bin_counts[g_bvh_bins]{};
+                            for (auto &bin : bin_bounds) bin = empty_aabb();
+                            for (u32 i = first; i < first + count; ++i)
+                            {
+                                const u32 bin = find_bin(centroids[primitives[i]], axis, centroid_box.min[axis], scale);
+                                grow(bin_bounds[bin], bounds[primitives[i]]);
+                                ++bin_counts[bin];
+                            }
+
+                            f32 right_costs[g_bvh_bins];
+                            AABB right = empty_aabb();
+                            u32 right_count = 0;
+                            for (u32 b = g_bvh_bins - 1; b > 0; --b)
+                            {
+                                grow(right, bin_bounds[b]);
+                                right_count += bin_counts[b];
+                                right_costs[b] = half_area(right) * right_count;
+                            }
+
+                            AABB left = empty_aabb();
+                            u32 left_count = 0;
+                            for (u32 b = 0; b + 1 < g_bvh_bins; ++b)
+                            {
+                                grow(left, bin_bounds[b]);
+                                left_count += bin_counts[b];
+                                if (left_count == 0 || left_count == count) continue;
+                                const f32 cost = half_area(left) * left_count + right_costs[b + 1];
+                                if (cost < best_cost)
+                                {
+                                    best_cost = cost;
+                                    best_axis = axis;
+                                    best_bin = b;
+                                }
+                            }
+                        }
+
+                        // Leaf cost is the primitive count, split cost is one traversal step plus the children
+                        const f32 area = half_area(box);
+                        if (count <= g_bvh_max_leaf_size &&
+                            (best_axis < 0 || area <= 0.0f || 1.0f + best_cost / area >= static_cast<f32>(count)))
+                            return;
+
+                        u32 middle = first + count / 2;
+                        if (best_axis >= 0)
+                        {
+                            const f32 scale = g_bvh_bins / extent[best_axis];
+                            const f32 min = centroid_box.min[best_axis];
+                            auto it = std::partition(primitives.begin() + first, primitives.begin() + first + count,
+                                                     [&](u32 primitive) {
+                                                         return find_bin(centroids[primitive], best_axis, min, scale) <=
+                                                                best_bin;
+                                                     });
+                            middle = static_cast<u32>(it - primitives.begin());
+                        }
+
+                        const u32 left = node_count.fetch_add(2, std::memory_order_relaxed);
+                        nodes[node].first = left;
+                        nodes[node].count = 0;
+                        const u32 left_count = middle - first, right_count = count - left_count;
+                        if (count > g_bvh_parallel_size)
+                            oneapi::tbb::parallel_invoke([&] { build(left, first, left_count); },
+                                                         [&] { build(left + 1, middle, right_count); });
+                        else
+                        {
+                            build(left, first, left_count);
+                            build(left + 1, middle, right_count);
+                        }
+                    }
+
+                    // Depth-first layout with siblings stored next to each other
+                    void flatten(acul::vector<BvhNode> &dst) const
+                    {
+                        dst.clear();
+                        dst.reserve(node_count.load(std::memory_order_relaxed));
+                        dst.push_back({});
+                        acul::vector<std::pair<u32, u32>> stack; // build node, destination node
+                        stack.push_back({0, 0});
+                        while (!stack.empty())
+                        {
+                            const auto [src, dst_index] = stack.back();
+                            stack.pop_back();
+                            const BuildNode &node = nodes[src];
+                            BvhNode flat{node.bounds.min, node.first, node.bounds.max, node.count};
+                            if (node.count == 0)
+                            {
+                                flat.first = static_cast<u32>(dst.size());
+                                dst.push_back({});
+                                dst.push_back({});
+                                stack.push_back({node.first + 1, flat.first + 1});
+                                stack.push_back({node.first, flat.first});
+                            }
+                            dst[dst_index] = flat;
+                        }
+                    }
+                };
+
+                // Visits primitives of all leaves accepted by `accept`, which also prunes inner nodes
+                template <typename Accept, typename Visitor>
+                void visit_nodes(const acul::vector<BvhNode> &nodes, const acul::vector<u32> &primitives,
+                                 Accept &&accept, Visitor &&visitor)
+                {
+                    if (nodes.empty()) return;
+                    acul::vector<u32> stack;
+                    stack.push_back(0);
+                    while (!stack.empty())
+                    {
+                        const BvhNode &node = nodes[stack.back()];
+                        stack.pop_back();
+                        if (!accept(AABB{node.min, node.max})) continue;
+                        if (node.is_leaf())
+                            for (u32 i = node.first; i < node.first + node.count; ++i) visitor(primitives[i]);
+                        else
+                        {
+                            stack.push_back(node.first + 1);
+                            stack.push_back(node.first);
+                        }
+                    }
+                }
+
+                template <typename Visitor>
+                void visit_overlaps(const acul::vector<BvhNode> &nodes, const acul::vector<u32> &primitives,
+                                    const AABB &box, Visitor &&visitor)
+                {
+                    visit_nodes(
+                        nodes, primitives, [&](const AABB &bounds) { return overlaps(bounds, box); }, visitor);
+                }
+
+                // Slab test. `t_entry` receives the entry distance on a hit.
+                inline bool intersect_box(const amal::vec3 &min, const amal::vec3 &max, const Ray &ray,
+                                          const amal::vec3 &inv_dir, f32 t_max, f32 &t_entry)
+                {
+                    f32 t0 = ray.t_min, t1 = t_max;
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        f32 near = (min[axis] - ray.origin[axis]) * inv_dir[axis];
+                        f32 far = (max[axis] - ray.origin[axis]) * inv_dir[axis];
+                        if (near > far) std::swap(near, far);
+                        // NaN from 0 * inf keeps the current interval
+                        if (near > t0) t0 = near;
+                        if (far < t1) t1 = far;
+                    }
+                    t_entry = t0;
+                    return t0 <= t1;
+                }
+
+                inline amal::vec3 inverse_direction(const Ray &ray)
+                {
+                    return amal::vec3(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+                }
+
+                // Moller-Trumbore, both faces are hit
+                inline bool intersect_triangle(const Ray &ray, const amal::vec3 &p0, const amal::vec3 &p1,
+                                               const amal::vec3 &p2, f32 t_max, RayHit &hit)
+                {
+                    const amal::vec3 e1 = p1 - p0, e2 = p2 - p0;
+                    const amal::vec3 p = amal::cross(ray.direction, e2);
+                    const f32 det = amal::dot(e1, p);
+                    if (det == 0.0f) return false;
+                    const f32 inv_det = 1.0f / det;
+                    const amal::vec3 s = ray.origin - p0;
+                    const f32 u = amal::dot(s, p) * inv_det;
+                    if (u < 0.0f || u > 1.0f) return false;
+                    const amal::vec3 q = amal::cross(s, e1);
+                    const f32 v = amal::dot(ray.direction, q) * inv_det;
+                    if (v < 0.0f || u + v > 1.0f) return false;
+                    const f32 t = amal::dot(e2, q) * inv_det;
+                    if (t < ray.t_min || t > t_max) return false;
+                    hit.t = t;
+                    hit.u = u;
+                    hit.v = v;
+                    return true;
+                }
+
+                bool intersect_ray(const Bvh &bvh, const acul::vector<Vertex> &vertices,
+                                   const acul::vector<u32> &indices, const Ray &ray, RayHit &hit)
+                {
+                    if (bvh.nodes.empty()) return false;
+                    const size_t triangle_count = indices.size() / 3;
+                    const amal::vec3 inv_dir = inverse_direction(ray);
+                    f32 closest = ray.t_max;
+                    bool found = false;
+                    acul::vector<u32> stack;
+                    stack.push_back(0);
+                    while (!stack.empty())
+                    {
+                        const BvhNode &node = bvh.nodes[stack.back()];
+                        stack.pop_back();
+                        f32 t_entry;
+                        if (!intersect_box(node.min, node.max, ray, inv_dir, closest, t_entry)) continue;
+                        if (node.is_leaf())
+                        {
+                            for (u32 i = node.first; i < node.first + node.count; ++i)
+                            {
+                                const u32 triangle = bvh.primitives[i];
+                                if (triangle >= triangle_count) continue;
+                                const u32 *tri = indices.data() + triangle * 3ULL;
+                                RayHit candidate;
+                                if (!intersect_triangle(ray, vertices[tri[0]].pos, vertices[tri[1]].pos,
+                                                        vertices[tri[2]].pos, closest, candidate))
+                                    continue;
+                                candidate.triangle = triangle;
+                                closest = candidate.t;
+                                hit = candidate;
+                                found = true;
+                            }
+                            continue;
+                        }
+
+                        // Visit the nearer child first
+                        const BvhNode &left_node = bvh.nodes[node.first], &right_node = bvh.nodes[node.first + 1];
+                        f32 left_t, right_t;
+                        const bool left = intersect_box(left_node.min, left_node.max, ray, inv_dir, closest, left_t);
+                        const bool right =
+                            intersect_box(right_node.min, right_node.max, ray, inv_dir, closest, right_t);
+                        if (left && right)
+                        {
+                            stack.push_back(left_t <= right_t ? node.first + 1 : node.first);
+                            stack.push_back(left_t <= right_t ? node.first : node.first + 1);
+                        }
+                        else if (left)
+                            stack.push_back(node.first);
+                        else if (right)
+                            stack.push_back(node.first + 1);
+                    }
+                    return found;
+                }
+
+                void fill_triangle_bounds(const acul::vector<Vertex> &vertices, const acul::vector<u32> &indices,
+                                          acul::vector<AABB> &bounds)
+                {
+                    using range = oneapi::tbb::blocked_range<size_t>;
+                    bounds.resize(indices.size() / 3);
+                    oneapi::tbb::parallel_for(range(0, bounds.size()), [&](const range &r) {
+                        for (size_t t = r.begin(); t < r.end(); ++t)
+                        {
+                            const amal::vec3 &p0 = vertices[indices[t * 3]].pos;
+                            bounds[t] = {p0, p0};
+                            grow(bounds[t], vertices[indices[t * 3 + 1]].pos);
+                            grow(bounds[t], vertices[indices[t * 3 + 2]].pos);
+                        }
+                    });
+                }
+
+                void query_triangles(const Bvh &bvh, const acul::vector<Vertex> &vertices,
+                                     const acul::vector<u32> &indices, const AABB &box, acul::vector<u32> &dst)
+                {
+                    const size_t triangle_count = indices.size() / 3;
+                    visit_overlaps(bvh.nodes, bvh.primitives, box, [&](u32 triangle) {
+                        if (triangle >= triangle_count) return;
+                        const u32 *tri = indices.data() + triangle * 3ULL;
+                        AABB bounds{vertices[tri[0]].pos, vertices[tri[0]].pos};
+                        grow(bounds, vertices[tri[1]].pos);
+                        grow(bounds, vertices[tri[2]].pos);
+                        if (overlaps(bounds, box)) dst.push_back(triangle);
+                    });
+                }
+            } // namespace
+
+            void build_bvh(const acul::vector<AABB> &bounds, acul::vector<BvhNode> &nodes,
+                           acul::vector<u32> &primitives)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                nodes.clear();
+                primitives.resize(bounds.size());
+                if (bounds.empty()) return;
+
+                BvhBuilder builder(bounds, primitives);
+                builder.centroids.resize(bounds.size());
+                builder.nodes.resize(bounds.size() * 2 - 1);
+                oneapi::tbb::parallel_for(range(0, bounds.size()), [&](const range &r) {
+                    for (size_t i = r.begin(); i < r.end(); ++i)
+                    {
+                        primitives[i] = static_cast<u32>(i);
+                        builder.centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+                    }
+                });
+                builder.build(0, 0, static_cast<u32>(bounds.size()));
+                builder.flatten(nodes);
+            }
+
+            void build_bvh(const Model &model, Bvh &dst)
+            {
+                acul::vector<AABB> bounds;
+                fill_triangle_bounds(model.vertices, model.indices, bounds);
+                build_bvh(bounds, dst.nodes, dst.primitives);
+            }
+
+            void build_bvh(const CompactModel &model, Bvh &dst)
+            {
+                acul::vector<AABB> bounds;
+                fill_triangle_bounds(model.vertices, model.indices, bounds);
+                build_bvh(bounds, dst.nodes, dst.primitives);
+            }
+
+            bool intersect_ray(const Bvh &bvh, const Model &model, const Ray &ray, RayHit &hit)
+            {
+                return intersect_ray(bvh, model.vertices, model.indices, ray, hit);
+            }
+
+            bool intersect_ray(const Bvh &bvh, const CompactModel &model, const Ray &ray, RayHit &hit)
+            {
+                return intersect_ray(bvh, model.vertices, model.indices, ray, hit);
+            }
+
+            void query_aabb(const acul::vector<BvhNode> &nodes, const acul::vector<u32> &primitives,
+                            const acul::vector<AABB> &bounds, const AABB &box, acul::vector<u32> &dst)
+            {
+                visit_overlaps(nodes, primitives, box, [&](u32 primitive) {
+                    if (primitive < bounds.size() && overlaps(bounds[primitive], box)) dst.push_back(primitive);
+                });
+            }
+
+            void query_aabb(const Bvh &bvh, const Model &model, const AABB &box, acul::vector<u32> &dst)
+            {
+                query_triangles(bvh, model.vertices, model.indices, box, dst);
+            }
+
+            void query_aabb(const Bvh &bvh, const CompactModel &model, const AABB &box, acul::vector<u32> &dst)
+            {
+                query_triangles(bvh, model.vertices, model.indices, box, dst);
+            }
+
+            AABB transform_aabb(const AABB &box, const Transform &transform)
+            {
+                const f32 cx = std::cos(transform.rotation.x), sx = std::sin(transform.rotation.x);
+                const f32 cy = std::cos(transform.rotation.y), sy = std::sin(transform.rotation.y);
+                const f32 cz = std::cos(transform.rotation.z), sz = std::sin(transform.rotation.z);
+                // Rz * Ry * Rx
+                const f32 rotation[3][3] = {{cz * cy, cz * sy * sx - sz * cx, cz * sy * cx + sz * sx},
+                                            {sz * cy, sz * sy * sx + cz * cx, sz * sy * cx - cz * sx},
+                                            {-sy, cy * sx, cy * cx}};
+
+                // Arvo's method: every output axis takes the extreme contributions of the input axes
+                AABB dst{transform.position, transform.position};
+                for (int i = 0; i < 3; ++i)
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        const f32 m = rotation[i][j] * transform.scale[j];
+                        const f32 a = m * box.min[j], b = m * box.max[j];
+                        dst.min[i] += amal::min(a, b);
+                        dst.max[i] += amal::max(a, b);
+                    }
+                return dst;
+            }
+        } // namespace mesh
+
+        namespace
+        {
+            // World bounds of objects with a mesh block, in object order
+            void collect_object_bounds(const Scene &scene, acul::vector<u64> &ids, acul::vector<mesh::AABB> &bounds)
+            {
+                const size_t object_count = scene.objects.size();
+                acul::vector<mesh::AABB> bounds_by_object(object_count);
+                acul::vector<u8> indexed(object_count, 0);
+                oneapi::tbb::parallel_for(size_t(0), object_count, [&](size_t i) {
+                    indexed[i] = object_bounds(scene.objects[i], bounds_by_object[i]);
+                });
+
+                ids.clear();
+                bounds.clear();
+                for (size_t i = 0; i < object_count; ++i)
+                {
+                    if (!indexed[i]) continue;
+                    ids.push_back(scene.objects[i].id);
+                    bounds.push_back(bounds_by_object[i]);
+                }
+            }
+
+            // SAH cost relative to the root area
+            f32 sah_cost(const acul::vector<mesh::BvhNode> &nodes)
+            {
+                if (nodes.empty()) return 0.0f;
+                const f32 root_area = mesh::half_area({nodes[0].min, nodes[0].max});
+                if (root_area <= 0.0f) return 0.0f;
+                f32 cost = 0.0f;
+                for (const auto &node : nodes)
+                    cost += mesh::half_area({node.min, node.max}) * (node.is_leaf() ? node.count : 1.0f);
+                return cost / root_area;
+            }
+
+            // Children are stored after their parents, so a reverse pass updates every node after its children
+            void refit(SceneIndex &index)
+            {
+                for (size_t i = index.nodes.size(); i-- > 0;)
+                {
+                    auto &node = index.nodes[i];
+                    mesh::AABB box = mesh::empty_aabb();
+                    if (node.is_leaf())
+                        for (u32 p = node.first; p < node.first + node.count; ++p)
+                            mesh::grow(box, index.bounds[index.primitives[p]]);
+                    else
+                    {
+                        const auto &left = index.nodes[node.first], &right = index.nodes[node.first + 1];
+                        box = {amal::min(left.min, right.min), amal::max(left.max, right.max)};
+                    }
+                    node.min = box.min;
+                    node.max = box.max;
+                }
+            }
+
+            // Plane test against the box corner that lies furthest along the plane normal
+            bool intersects(const Frustum &frustum, const mesh::AABB &box)
+            {
+                for (const auto &plane : frustum.planes)
+                {
+                    amal::vec3 corner;
+                    for (int axis = 0; axis < 3; ++axis)
+                        corner[axis] = plane.normal[axis] >= 0.0f ? box.max[axis] : box.min[axis];
+                    if (amal::dot(plane.normal, corner) + plane.distance < 0.0f) return false;
+                }
+                return true;
+            }
+        } // namespace
+
+        bool object_bounds(const Object &object, mesh::AABB &dst)
+        {
+            for (const auto &block : object.meta)
+            {
+                if (!block) continue;
+                if (block->signature() == sign_block::mesh_instance)
+                {
+                    auto *instance = static_cast<const mesh::Instance *>(block.get());
+                    if (!instance->mesh) continue;
+                    dst = mesh::transform_aabb(instance->mesh->model.aabb, instance->transform);
+                    return true;
+                }
+                if (block->signature() == sign_block::mesh)
+                {
+                    auto *mesh = static_cast<const mesh::Mesh *>(block.get());
+                    dst = mesh::transform_aabb(mesh->model.aabb, mesh->transform);
+                    return true;
+                }
+                if (block->signature() == sign_block::compact_mesh)
+                {
+                    auto *compact = static_cast<const mesh::CompactMesh *>(block.get());
+                    dst = mesh::transform_aabb(compact->model.aabb, compact->transform);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void build_scene_index(const Scene &scene, SceneIndex &dst)
+        {
+            collect_object_bounds(scene, dst.ids, dst.bounds);
+            mesh::build_bvh(dst.bounds, dst.nodes, dst.primitives);
+            dst.build_cost = sah_cost(dst.nodes);
+        }
+
+        bool update_scene_index(const Scene &scene, SceneIndex &index)
+        {
+            // Refitting trades tree quality for speed, rebuild once the cost grows past this factor
+            constexpr f32 max_cost_growth = 1.5f;
+
+            acul::vector<u64> ids;
+            acul::vector<mesh::AABB> bounds;
+            collect_object_bounds(scene, ids, bounds);
+            const bool same_objects = ids == index.ids && index.primitives.size() == ids.size();
+            index.ids = std::move(ids);
+            index.bounds = std::move(bounds);
+            if (same_objects)
+            {
+                refit(index);
+                if (sah_cost(index.nodes) <= index.build_cost * max_cost_growth) return false;
+            }
+            mesh::build_bvh(index.bounds, index.nodes, index.primitives);
+            index.build_cost = sah_cost(index.nodes);
+            return true;
+        }
+
+        void query_frustum(const SceneIndex &index, const Frustum &frustum, acul::vector<u64> &ids)
+        {
+            mesh::visit_nodes(
+                index.nodes, index.primitives, [&](const mesh::AABB &box) { return intersects(frustum, box); },
+                [&](u32 slot) {
+                    if (intersects(frustum, index.bounds[slot])) ids.push_back(index.ids[slot]);
+                });
+        }
+
+        void query_aabb(const SceneIndex &index, const mesh::AABB &box, acul::vector<u64> &ids)
+        {
+            mesh::visit_overlaps(index.nodes, index.primitives, box, [&](u32 slot) {
+                if (mesh::overlaps(index.bounds[slot], box)) ids.push_back(index.ids[slot]);
+            });
+        }
+
+        void query_ray(const SceneIndex &index, const mesh::Ray &ray, acul::vector<u64> &ids)
+        {
+            const amal::vec3 inv_dir = mesh::inverse_direction(ray);
+            auto hits = [&](const mesh::AABB &box) {
+                f32 t_entry;
+                return mesh::intersect_box(box.min, box.max, ray, inv_dir, ray.t_max, t_entry);
+            };
+            mesh::visit_nodes(index.nodes, index.primitives, hits, [&](u32 slot) {
+                if (hits(index.bounds[slot])) ids.push_back(index.ids[slot]);
+            });
+        }
+    } // namespace utils
+} // namespace umbf
@@ -0,0 +1,2103 @@
+#include <algorithm>
+#include <amal/half.hpp>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+#include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/parallel_reduce.h>
+#include <oneapi/tbb/parallel_sort.h>
+#include <umbf/utils.hpp>
+
+namespace umbf
+{
+    namespace utils
+    {
+        namespace mesh
+        {
+            void fill_face_table(const acul::vector<Face> &faces, FaceTable &dst)
+            {
+                const size_t face_count = faces.size();
+                dst.offsets.resize(face_count + 1);
+                dst.normals.resize(face_count);
+                dst.first_index.resize(face_count);
+                dst.index_count.resize(face_count);
+
+                dst.offsets[0] = 0;
+                for (size_t f = 0; f < face_count; ++f)
+                    dst.offsets[f + 1] = dst.offsets[f] + static_cast<u32>(faces[f].vertices.size());
+                dst.refs.resize(dst.offsets.back());
+
+                oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0, face_count),
+                                          [&](const oneapi::tbb::blocked_range<size_t> &r) {
+                                              for (size_t f = r.begin(); f < r.end(); ++f)
+                                              {
+                                                  const auto &face = faces[f];
+                                                  std::copy(face.vertices.begin(), face.vertices.end(),
+                                                            dst.refs.data() + dst.offsets[f]);
+                                                  dst.normals[f] = face.normal;
+                                                  dst.first_index[f] = face.first_vertex;
+                                                  dst.index_count[f] = face.count;
+                                              }
+                                          });
+            }
+
+            void expand_face_table(const FaceTable &src, acul::vector<Face> &dst)
+            {
+                dst.resize(src.size());
+                oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0, src.size()),
+                                          [&](const oneapi::tbb::blocked_range<size_t> &r) {
+                                              for (size_t f = r.begin(); f < r.end(); ++f)
+                                              {
+                                                  auto &face = dst[f];
+                                                  const VertexRef *refs = src.face_refs(f);
+                                                  face.vertices.resize(src.ref_count(f));
+                                                  std::copy(refs, refs + src.ref_count(f), face.vertices.data());
+                                                  face.normal = src.normals[f];
+                                                  face.first_vertex = src.first_index[f];
+                                                  face.count = src.index_count[f];
+                                              }
+                                          });
+            }
+
+            // Face `f` owns references `[ref_offsets[f], ref_offsets[f + 1])`, `get_ref(f, k)` returns the k-th one
+            template <typename RefGetter>
+            static void build_vertex_group_table(const acul::vector<u32> &ref_offsets, u32 group_count,
+                                                 RefGetter &&get_ref, VertexGroupTable &table)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                const size_t face_count = ref_offsets.size() - 1;
+                const size_t ref_count = ref_offsets.back();
+
+                // Counting pass
+                acul::vector<std::atomic<u32>> cursors(group_count);
+                for (auto &cursor : cursors) cursor.store(0, std::memory_order_relaxed);
+                oneapi::tbb::parallel_for(range(0, face_count), [&](const range &r) {
+                    for (size_t f = r.begin(); f < r.end(); ++f)
+                        for (u32 k = 0; k < ref_offsets[f + 1] - ref_offsets[f]; ++k)
+                        {
+                            const u32 group = get_ref(f, k).group;
+                            assert(group < group_count);
+                            cursors[group].fetch_add(1, std::memory_order_relaxed);
+                        }
+                });
+
+                // Prefix sum
+                table.offsets.resize(group_count + 1);
+                table.offsets[0] = 0;
+                for (u32 g = 0; g < group_count; ++g)
+                {
+                    table.offsets[g + 1] = table.offsets[g] + cursors[g].load(std::memory_order_relaxed);
+                    cursors[g].store(table.offsets[g], std::memory_order_relaxed);
+                }
+
+                // Scatter pass. Slots are taken in arbitrary order, so every entry keeps its global reference
+                // index in the high bits and its face in the low bits to restore the face order afterwards.
+                acul::vector<u64> entries(ref_count);
+                oneapi::tbb::parallel_for(range(0, face_count), [&](const range &r) {
+                    for (size_t f = r.begin(); f < r.end(); ++f)
+                        for (u32 k = 0; k < ref_offsets[f + 1] - ref_offsets[f]; ++k)
+                        {
+                            const u32 slot = cursors[get_ref(f, k).group].fetch_add(1, std::memory_order_relaxed);
+                            entries[slot] = (static_cast<u64>(ref_offsets[f] + k) << 32) | f;
+                        }
+                });
+
+                table.faces.resize(ref_count);
+                table.vertices.resize(ref_count);
+                oneapi::tbb::parallel_for(range(0, group_count), [&](const range &r) {
+                    for (size_t g = r.begin(); g < r.end(); ++g)
+                    {
+                        const u32 first = table.offsets[g], last = table.offsets[g + 1];
+                        std::sort(entries.begin() + first, entries.begin() + last);
+                        for (u32 i = first; i < last; ++i)
+                        {
+                            const u32 face = static_cast<u32>(entries[i]);
+                            const u32 ref = static_cast<u32>(entries[i] >> 32);
+                            table.faces[i] = face;
+                            table.vertices[i] = get_ref(face, ref - ref_offsets[face]).vertex;
+                        }
+                    }
+                });
+            }
+
+            void fill_vertex_groups(const Model &model, VertexGroupTable &table)
+            {
+                acul::vector<u32> ref_offsets(model.faces.size() + 1);
+                ref_offsets[0] = 0;
+                for (size_t f = 0; f < model.faces.size(); ++f)
+                    ref_offsets[f + 1] = ref_offsets[f] + static_cast<u32>(model.faces[f].vertices.size());
+                build_vertex_group_table(
+                    ref_offsets, model.group_count,
+                    [&](size_t face, u32 k) -> const VertexRef & { return model.faces[face].vertices[k]; }, table);
+            }
+
+            void fill_vertex_groups(const CompactModel &model, VertexGroupTable &table)
+            {
+                if (model.faces.offsets.empty())
+                {
+                    table.offsets = acul::vector<u32>(model.group_count + 1, 0);
+                    table.faces.clear();
+                    table.vertices.clear();
+                    return;
+                }
+                build_vertex_group_table(
+                    model.faces.offsets, model.group_count,
+                    [&](size_t face, u32 k) -> const VertexRef & { return model.faces.face_refs(face)[k]; }, table);
+            }
+
+            void expand_vertex_groups(const VertexGroupTable &table, acul::vector<VertexGroup> &groups)
+            {
+                groups.resize(table.size());
+                oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0, table.size()),
+                                          [&](const oneapi::tbb::blocked_range<size_t> &r) {
+                                              for (size_t g = r.begin(); g < r.end(); ++g)
+                                              {
+                                                  const u32 first = table.offsets[g], last = table.offsets[g + 1];
+                                                  groups[g].faces.resize(last - first);
+                                                  groups[g].vertices.resize(last - first);
+                                                  std::copy(table.faces.data() + first, table.faces.data() + last,
+                                                            groups[g].faces.data());
+                                                  std::copy(table.vertices.data() + first,
+                                                            table.vertices.data() + last, groups[g].vertices.data());
+                                              }
+                                          });
+            }
+
+            void fill_vertex_groups(const Model &model, acul::vector<VertexGroup> &groups)
+            {
+                VertexGroupTable table;
+                fill_vertex_groups(model, table);
+                expand_vertex_groups(table, groups);
+            }
+
+            namespace
+            {
+                struct HalfEdgeKey
+                {
+                    u64 groups; ///< Smaller group in the high bits, larger group in the low bits.
+                    u32 half_edge;
+
+                    bool operator<(const HalfEdgeKey &other) const
+                    {
+                        return groups != other.groups ? groups < other.groups : half_edge < other.half_edge;
+                    }
+                };
+            } // namespace
+
+            // Face `f` owns references `[ref_offsets[f], ref_offsets[f + 1])`, `get_ref(f, k)` returns the k-th one
+            template <typename RefGetter>
+            static void build_half_edge_table(const acul::vector<u32> &ref_offsets, RefGetter &&get_ref,
+                                              HalfEdgeTable &table)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                const size_t face_count = ref_offsets.size() - 1;
+                const size_t half_edge_count = ref_offsets.back();
+                table.offsets = ref_offsets;
+                table.faces.resize(half_edge_count);
+                table.twins.resize(half_edge_count);
+                table.edges.resize(half_edge_count);
+
+                // Origin and destination of half-edge `h` within face `f`
+                auto ends = [&](size_t f, u32 h) {
+                    const u32 k = h - ref_offsets[f];
+                    const u32 n = ref_offsets[f + 1] - ref_offsets[f];
+                    return std::pair<const VertexRef &, const VertexRef &>(get_ref(f, k), get_ref(f, (k + 1) % n));
+                };
+
+                acul::vector<HalfEdgeKey> keys(half_edge_count);
+                oneapi::tbb::parallel_for(range(0, face_count), [&](const range &r) {
+                    for (size_t f = r.begin(); f < r.end(); ++f)
+                        for (u32 h = ref_offsets[f]; h < ref_offsets[f + 1]; ++h)
+                        {
+                            const auto [a, b] = ends(f, h);
+                            const u32 lo = std::min(a.group, b.group), hi = std::max(a.group, b.group);
+                            keys[h] = {(static_cast<u64>(lo) << 32) | hi, h};
+                            table.faces[h] = static_cast<u32>(f);
+                        }
+                });
+                oneapi::tbb::parallel_sort(keys.begin(), keys.end());
+
+                // Runs of equal keys are the undirected edges
+                acul::vector<u32> run_starts;
+                for (u32 i = 0; i < half_edge_count; ++i)
+                    if (i == 0 || keys[i].groups != keys[i - 1].groups) run_starts.push_back(i);
+                run_starts.push_back(static_cast<u32>(half_edge_count));
+
+                const size_t edge_count = run_starts.size() - 1;
+                table.edge_flags.resize(edge_count);
+                oneapi::tbb::parallel_for(range(0, edge_count), [&](const range &r) {
+                    for (size_t e = r.begin(); e < r.end(); ++e)
+                    {
+                        const u32 first = run_starts[e], last = run_starts[e + 1];
+                        EdgeFlags flags = EdgeFlagBits::none;
+                        for (u32 i = first; i < last; ++i)
+                        {
+                            table.edges[keys[i].half_edge] = static_cast<u32>(e);
+                            table.twins[keys[i].half_edge] = HalfEdgeTable::invalid;
+                        }
+                        if (last - first == 1)
+                            flags |= EdgeFlagBits::boundary;
+                        else if (last - first > 2)
+                            flags |= EdgeFlagBits::non_manifold;
+                        else
+                        {
+                            const u32 h0 = keys[first].half_edge, h1 = keys[first + 1].half_edge;
+                            const auto [a0, b0] = ends(table.faces[h0], h0);
+                            const auto [a1, b1] = ends(table.faces[h1], h1);
+                            if (a0.group != b1.group || b0.group != a1.group)
+                                flags |= EdgeFlagBits::non_manifold;
+                            else
+                            {
+                                table.twins[h0] = h1;
+                                table.twins[h1] = h0;
+                                if (a0.vertex != b1.vertex || b0.vertex != a1.vertex) flags |= EdgeFlagBits::seam;
+                            }
+                        }
+                        table.edge_flags[e] = flags;
+                    }
+                });
+            }
+
+            void build_half_edges(const Model &model, HalfEdgeTable &table)
+            {
+                acul::vector<u32> ref_offsets(model.faces.size() + 1);
+                ref_offsets[0] = 0;
+                for (size_t f = 0; f < model.faces.size(); ++f)
+                    ref_offsets[f + 1] = ref_offsets[f] + static_cast<u32>(model.faces[f].vertices.size());
+                build_half_edge_table(
+                    ref_offsets,
+                    [&](size_t face, u32 k) -> const VertexRef & { return model.faces[face].vertices[k]; }, table);
+            }
+
+            void build_half_edges(const CompactModel &model, HalfEdgeTable &table)
+            {
+                if (model.faces.offsets.empty())
+                {
+                    table = HalfEdgeTable{};
+                    table.offsets.push_back(0);
+                    return;
+                }
+                build_half_edge_table(
+                    model.faces.offsets,
+                    [&](size_t face, u32 k) -> const VertexRef & { return model.faces.face_refs(face)[k]; }, table);
+            }
+
+            CacheStats analyze_vertex_cache(const acul::vector<u32> &indices, size_t vertex_count, u32 cache_size)
+            {
+                // FIFO emulation: a vertex is cached while fewer than `cache_size` misses happened after its own
+                acul::vector<u32> stamps(vertex_count, 0);
+                u32 timestamp = cache_size + 1;
+                u32 misses = 0, referenced = 0;
+                for (u32 index : indices)
+                {
+                    if (stamps[index] == 0) ++referenced;
+                    if (timestamp - stamps[index] > cache_size)
+                    {
+                        stamps[index] = timestamp++;
+                        ++misses;
+                    }
+                }
+
+                CacheStats stats;
+                const size_t triangle_count = indices.size() / 3;
+                if (triangle_count > 0) stats.acmr = static_cast<f32>(misses) / triangle_count;
+                if (referenced > 0) stats.atvr = static_cast<f32>(misses) / referenced;
+                return stats;
+            }
+
+            struct IndexRange
+            {
+                u32 first;
+                u32 count;
+            };
+
+            static bool is_live(const acul::vector<u32> &live, i64 vertex) { return vertex >= 0 && live[vertex] > 0; }
+
+            // Tipsify (Sander et al. 2007) over index ranges. Returns the emission order of `units`.
+            static void tipsify(const acul::vector<u32> &indices, const acul::vector<IndexRange> &units,
+                                size_t vertex_count, u32 cache_size, acul::vector<u32> &order)
+            {
+                // Vertex -> units adjacency
+                acul::vector<u32> offsets(vertex_count + 1, 0);
+                for (const auto &unit : units)
+                    for (u32 i = unit.first; i < unit.first + unit.count; ++i) ++offsets[indices[i] + 1];
+                for (size_t v = 0; v < vertex_count; ++v) offsets[v + 1] += offsets[v];
+                acul::vector<u32> live(vertex_count);
+                for (size_t v = 0; v < vertex_count; ++v) live[v] = offsets[v + 1] - offsets[v];
+                acul::vector<u32> adjacency(offsets.back());
+                {
+                    acul::vector<u32> cursor(offsets.begin(), offsets.end() - 1);
+                    for (u32 u = 0; u < units.size(); ++u)
+                        for (u32 i = units[u].first; i < units[u].first + units[u].count; ++i)
+                            adjacency[cursor[indices[i]]++] = u;
+                }
+
+                acul::vector<u32> stamps(vertex_count, 0);
+                acul::vector<bool> emitted(units.size(), false);
+                acul::vector<u32> dead_end;
+                acul::vector<u32> candidates;
+                u32 timestamp = cache_size + 1;
+                size_t cursor = 0;
+                order.clear();
+                order.reserve(units.size());
+
+                i64 fanning = vertex_count > 0 ? 0 : -1;
+                while (fanning >= 0)
+                {
+                    candidates.clear();
+                    for (u32 a = offsets[fanning]; a < offsets[fanning + 1]; ++a)
+                    {
+                        const u32 u = adjacency[a];
+                        if (emitted[u]) continue;
+                        for (u32 i = units[u].first; i < units[u].first + units[u].count; ++i)
+                        {
+                            const u32 v = indices[i];
+                            dead_end.push_back(v);
+                            candidates.push_back(v);
+                            --live[v];
+                            if (timestamp - stamps[v] > cache_size) stamps[v] = timestamp++;
+                        }
+                        emitted[u] = true;
+                        order.push_back(u);
+                    }
+
+                    // Next fanning vertex: the candidate that stays in the cache longest while all its
+                    // remaining faces are emitted
+                    i64 next = -1;
+                    i64 best_priority = -1;
+                    for (u32 v : candidates)
+                    {
+                        if (live[v] == 0) continue;
+                        i64 priority = 0;
+                        if (timestamp - stamps[v] + 2 * live[v] <= cache_size) priority = timestamp - stamps[v];
+                        if (priority > best_priority)
+                        {
+                            best_priority = priority;
+                            next = v;
+                        }
+                    }
+
+                    if (next < 0)
+                    {
+                        while (!dead_end.empty() && !is_live(live, next))
+                        {
+                            next = dead_end.back();
+                            dead_end.pop_back();
+                        }
+                        if (!is_live(live, next))
+                        {
+                            next = -1;
+                            while (cursor < vertex_count && live[cursor] == 0) ++cursor;
+                            if (cursor < vertex_count) next = static_cast<i64>(cursor);
+                        }
+                    }
+                    fanning = next;
+                }
+
+                // Units without vertices are never reached through the adjacency
+                for (u32 u = 0; u < units.size(); ++u)
+                    if (!emitted[u]) order.push_back(u);
+            }
+
+            template <typename GetRange, typename SetFirst>
+            static void reorder_index_ranges(acul::vector<u32> &indices, size_t vertex_count, size_t face_count,
+                                             u32 cache_size, GetRange &&get_range, SetFirst &&set_first)
+            {
+                const bool per_triangle = face_count == 0;
+                acul::vector<IndexRange> units(per_triangle ? indices.size() / 3 : face_count);
+                for (u32 u = 0; u < units.size(); ++u)
+                    units[u] = per_triangle ? IndexRange{u * 3, 3} : get_range(u);
+
+                acul::vector<u32> order;
+                tipsify(indices, units, vertex_count, cache_size, order);
+
+                acul::vector<u32> reordered;
+                reordered.reserve(indices.size());
+                for (u32 u : order)
+                {
+                    if (!per_triangle) set_first(u, static_cast<u32>(reordered.size()));
+                    reordered.insert(reordered.end(), indices.begin() + units[u].first,
+                                     indices.begin() + units[u].first + units[u].count);
+                }
+                // Keep indices not covered by any face
+                if (reordered.size() < indices.size())
+                {
+                    acul::vector<bool> covered(indices.size(), false);
+                    for (const auto &unit : units)
+                        std::fill(covered.begin() + unit.first, covered.begin() + unit.first + unit.count, true);
+                    for (size_t i = 0; i < indices.size(); ++i)
+                        if (!covered[i]) reordered.push_back(indices[i]);
+                }
+                indices = std::move(reordered);
+            }
+
+            // Sorts vertices by first use in the index buffer, unreferenced vertices are kept at the end
+            static void build_fetch_remap(const acul::vector<u32> &indices, size_t vertex_count,
+                                          acul::vector<u32> &remap)
+            {
+                constexpr u32 unassigned = UINT32_MAX;
+                remap.assign(vertex_count, unassigned);
+                u32 next = 0;
+                for (u32 index : indices)
+                    if (remap[index] == unassigned) remap[index] = next++;
+                for (auto &id : remap)
+                    if (id == unassigned) id = next++;
+            }
+
+            static void apply_fetch_remap(const acul::vector<u32> &remap, acul::vector<Vertex> &vertices,
+                                          acul::vector<u32> &indices)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                acul::vector<Vertex> reordered(vertices.size());
+                oneapi::tbb::parallel_for(range(0, vertices.size()), [&](const range &r) {
+                    for (size_t v = r.begin(); v < r.end(); ++v) reordered[remap[v]] = vertices[v];
+                });
+                vertices = std::move(reordered);
+                oneapi::tbb::parallel_for(range(0, indices.size()), [&](const range &r) {
+                    for (size_t i = r.begin(); i < r.end(); ++i) indices[i] = remap[indices[i]];
+                });
+            }
+
+            VertexCacheReport optimize_vertex_cache(Model &model, u32 cache_size)
+            {
+                VertexCacheReport report;
+                report.before = analyze_vertex_cache(model.indices, model.vertices.size(), cache_size);
+                reorder_index_ranges(
+                    model.indices, model.vertices.size(), model.faces.size(), cache_size,
+                    [&](u32 f) { return IndexRange{model.faces[f].first_vertex, model.faces[f].count}; },
+                    [&](u32 f, u32 first) { model.faces[f].first_vertex = first; });
+
+                acul::vector<u32> remap;
+                build_fetch_remap(model.indices, model.vertices.size(), remap);
+                apply_fetch_remap(remap, model.vertices, model.indices);
+                oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0, model.faces.size()),
+                                          [&](const oneapi::tbb::blocked_range<size_t> &r) {
+                                              for (size_t f = r.begin(); f < r.end(); ++f)
+                                                  for (auto &ref : model.faces[f].vertices)
+                                                      ref.vertex = remap[ref.vertex];
+                                          });
+                report.after = analyze_vertex_cache(model.indices, model.vertices.size(), cache_size);
+                return report;
+            }
+
+            VertexCacheReport optimize_vertex_cache(CompactModel &model, u32 cache_size)
+            {
+                auto &faces = model.faces;
+                VertexCacheReport report;
+                report.before = analyze_vertex_cache(model.indices, model.vertices.size(), cache_size);
+                reorder_index_ranges(
+                    model.indices, model.vertices.size(), faces.size(), cache_size,
+                    [&](u32 f) { return IndexRange{faces.first_index[f], faces.index_count[f]}; },
+                    [&](u32 f, u32 first) { faces.first_index[f] = first; });
+
+                acul::vector<u32> remap;
+                build_fetch_remap(model.indices, model.vertices.size(), remap);
+                apply_fetch_remap(remap, model.vertices, model.indices);
+                oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0, faces.refs.size()),
+                                          [&](const oneapi::tbb::blocked_range<size_t> &r) {
+                                              for (size_t i = r.begin(); i < r.end(); ++i)
+                                                  faces.refs[i].vertex = remap[faces.refs[i].vertex];
+                                          });
+                report.after = analyze_vertex_cache(model.indices, model.vertices.size(), cache_size);
+                return report;
+            }
+
+            AABB compute_aabb(const acul::vector<Vertex> &vertices)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                if (vertices.empty()) return {amal::vec3(0.0f), amal::vec3(0.0f)};
+                const AABB identity{vertices.front().pos, vertices.front().pos};
+                return oneapi::tbb::parallel_reduce(
+                    range(0, vertices.size(), 4096), identity,
+                    [&](const range &r, AABB box) {
+                        // Branchless loop, lets the compiler keep min/max in vector registers
+                        for (size_t i = r.begin(); i < r.end(); ++i)
+                        {
+                            box.min = amal::min(box.min, vertices[i].pos);
+                            box.max = amal::max(box.max, vertices[i].pos);
+                        }
+                        return box;
+                    },
+                    [](const AABB &lhs, const AABB &rhs) -> AABB {
+                        return {amal::min(lhs.min, rhs.min), amal::max(lhs.max, rhs.max)};
+                    });
+            }
+
+            namespace
+            {
+                struct ModelFaces
+                {
+                    Model &model;
+
+                    size_t size() const { return model.faces.size(); }
+                    u32 ref_count(size_t f) const { return static_cast<u32>(model.faces[f].vertices.size()); }
+                    const VertexRef &ref(size_t f, u32 k) const { return model.faces[f].vertices[k]; }
+                    amal::vec3 &normal(size_t f) { return model.faces[f].normal; }
+                };
+
+                struct CompactModelFaces
+                {
+                    CompactModel &model;
+
+                    size_t size() const { return model.faces.size(); }
+                    u32 ref_count(size_t f) const { return model.faces.ref_count(f); }
+                    const VertexRef &ref(size_t f, u32 k) const { return model.faces.face_refs(f)[k]; }
+                    amal::vec3 &normal(size_t f) { return model.faces.normals[f]; }
+                };
+            } // namespace
+
+            // Newell's method. The length of the result equals twice the polygon area.
+            template <typename Faces>
+            static amal::vec3 newell_normal(const Faces &faces, const acul::vector<Vertex> &vertices, size_t f)
+            {
+                amal::vec3 normal(0.0f);
+                const u32 ref_count = faces.ref_count(f);
+                for (u32 k = 0; k < ref_count; ++k)
+                {
+                    const amal::vec3 &a = vertices[faces.ref(f, k).vertex].pos;
+                    const amal::vec3 &b = vertices[faces.ref(f, (k + 1) % ref_count).vertex].pos;
+                    normal.x += (a.y - b.y) * (a.z + b.z);
+                    normal.y += (a.z - b.z) * (a.x + b.x);
+                    normal.z += (a.x - b.x) * (a.y + b.y);
+                }
+                return normal;
+            }
+
+            static inline amal::vec3 safe_normalize(const amal::vec3 &v)
+            {
+                const f32 length = amal::sqrt(amal::dot(v, v));
+                return length > 0.0f ? v / length : amal::vec3(0.0f);
+            }
+
+            template <typename Faces>
+            static void recompute_face_normals(Faces faces, const acul::vector<Vertex> &vertices,
+                                               acul::vector<amal::vec3> *weighted)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                if (weighted) weighted->resize(faces.size());
+                oneapi::tbb::parallel_for(range(0, faces.size()), [&](const range &r) {
+                    for (size_t f = r.begin(); f < r.end(); ++f)
+                    {
+                        const amal::vec3 normal = newell_normal(faces, vertices, f);
+                        if (weighted) (*weighted)[f] = normal;
+                        faces.normal(f) = safe_normalize(normal);
+                    }
+                });
+            }
+
+            template <typename Faces>
+            static f32 corner_angle(const Faces &faces, const acul::vector<Vertex> &vertices, size_t f, u32 vertex)
+            {
+                const u32 ref_count = faces.ref_count(f);
+                for (u32 k = 0; k < ref_count; ++k)
+                {
+                    if (faces.ref(f, k).vertex != vertex) continue;
+                    const amal::vec3 &p = vertices[vertex].pos;
+                    const u32 prev = faces.ref(f, (k + ref_count - 1) % ref_count).vertex;
+                    const u32 next = faces.ref(f, (k + 1) % ref_count).vertex;
+                    const amal::vec3 a = safe_normalize(vertices[prev].pos - p);
+                    const amal::vec3 b = safe_normalize(vertices[next].pos - p);
+                    return std::acos(amal::max(-1.0f, amal::min(1.0f, amal::dot(a, b))));
+                }
+                return 0.0f;
+            }
+
+            template <typename Faces>
+            static void recompute_normals(Faces faces, acul::vector<Vertex> &vertices, const VertexGroupTable &groups,
+                                          NormalWeighting::enum_type weighting)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                acul::vector<amal::vec3> weighted;
+                recompute_face_normals(faces, vertices, &weighted);
+
+                // Entries of a group follow the face order, so a group with several vertices (a UV or normal seam)
+                // interleaves them. Each slice is sorted by (vertex, face) to sum every vertex over one run.
+                // A vertex belongs to a single group, hence every vertex is written by one task only.
+                oneapi::tbb::parallel_for(range(0, groups.size()), [&](const range &r) {
+                    acul::vector<u64> entries;
+                    for (size_t g = r.begin(); g < r.end(); ++g)
+                    {
+                        const u32 first = groups.offsets[g], last = groups.offsets[g + 1];
+                        entries.resize(last - first);
+                        for (u32 i = first; i < last; ++i)
+                            entries[i - first] = (static_cast<u64>(groups.vertices[i]) << 32) | groups.faces[i];
+                        std::sort(entries.begin(), entries.end());
+                        for (size_t i = 0; i < entries.size();)
+                        {
+                            const u32 vertex = static_cast<u32>(entries[i] >> 32);
+                            amal::vec3 sum(0.0f);
+                            for (; i < entries.size() && static_cast<u32>(entries[i] >> 32) == vertex; ++i)
+                            {
+                                const u32 face = static_cast<u32>(entries[i]);
+                                if (weighting == NormalWeighting::area)
+                                    sum += weighted[face];
+                                else
+                                    sum += faces.normal(face) * corner_angle(faces, vertices, face, vertex);
+                            }
+                            vertices[vertex].normal = safe_normalize(sum);
+                        }
+                    }
+                });
+            }
+
+            void recompute_face_normals(Model &model)
+            {
+                recompute_face_normals(ModelFaces{model}, model.vertices, nullptr);
+            }
+
+            void recompute_face_normals(CompactModel &model)
+            {
+                recompute_face_normals(CompactModelFaces{model}, model.vertices, nullptr);
+            }
+
+            void recompute_normals(Model &model, const VertexGroupTable &groups, NormalWeighting::enum_type weighting)
+            {
+                recompute_normals(ModelFaces{model}, model.vertices, groups, weighting);
+            }
+
+            void recompute_normals(CompactModel &model, const VertexGroupTable &groups,
+                                   NormalWeighting::enum_type weighting)
+            {
+                recompute_normals(CompactModelFaces{model}, model.vertices, groups, weighting);
+            }
+
+            namespace
+            {
+                struct MeshletChunk
+                {
+                    acul::vector<Meshlet> meshlets;
+                    acul::vector<u32> vertices;
+                    acul::vector<u8> triangles;
+                };
+            } // namespace
+
+            // Greedy clustering of triangles [first, last) in index order
+            static void build_meshlet_chunk(const acul::vector<u32> &indices, size_t first, size_t last,
+                                            u32 max_vertices, u32 max_triangles, MeshletChunk &chunk)
+            {
+                Meshlet current{};
+                auto flush = [&]() {
+                    if (current.triangle_count == 0) return;
+                    chunk.meshlets.push_back(current);
+                    current = {};
+                    current.vertex_offset = static_cast<u32>(chunk.vertices.size());
+                    current.triangle_offset = static_cast<u32>(chunk.triangles.size());
+                };
+
+                for (size_t t = first; t < last;)
+                {
+                    const u32 *triangle = indices.data() + t * 3;
+                    u32 local[3];
+                    u32 added = 0;
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        local[k] = UINT32_MAX;
+                        for (u32 v = 0; v < current.vertex_count; ++v)
+                            if (chunk.vertices[current.vertex_offset + v] == triangle[k]) local[k] = v;
+                        for (int j = 0; j < k; ++j)
+                            if (local[k] == UINT32_MAX && triangle[j] == triangle[k]) local[k] = local[j];
+                        if (local[k] == UINT32_MAX) local[k] = current.vertex_count + added++;
+                    }
+
+                    if (current.vertex_count + added > max_vertices || current.triangle_count + 1 > max_triangles)
+                    {
+                        // Retry the triangle in an empty meshlet
+                        flush();
+                        continue;
+                    }
+
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        if (local[k] == current.vertex_count)
+                        {
+                            chunk.vertices.push_back(triangle[k]);
+                            ++current.vertex_count;
+                        }
+                        chunk.triangles.push_back(static_cast<u8>(local[k]));
+                    }
+                    ++current.triangle_count;
+                    ++t;
+                }
+                flush();
+            }
+
+            static void compute_meshlet_bounds(const acul::vector<Vertex> &vertices, const Meshlets &meshlets,
+                                               Meshlet &meshlet)
+            {
+                const u32 *ids = meshlets.vertices.data() + meshlet.vertex_offset;
+                amal::vec3 min = vertices[ids[0]].pos, max = min;
+                for (u32 v = 1; v < meshlet.vertex_count; ++v)
+                {
+                    min = amal::min(min, vertices[ids[v]].pos);
+                    max = amal::max(max, vertices[ids[v]].pos);
+                }
+                meshlet.center = (min + max) * 0.5f;
+                f32 radius = 0.0f;
+                for (u32 v = 0; v < meshlet.vertex_count; ++v)
+                {
+                    const amal::vec3 d = vertices[ids[v]].pos - meshlet.center;
+                    radius = amal::max(radius, amal::dot(d, d));
+                }
+                meshlet.radius = amal::sqrt(radius);
+
+                // Normal cone over all triangles. Normals are recomputed in the second pass instead of being stored.
+                const u8 *triangles = meshlets.triangles.data() + meshlet.triangle_offset;
+                auto triangle_normal = [&](u32 t) {
+                    const amal::vec3 &a = vertices[ids[triangles[t * 3]]].pos;
+                    const amal::vec3 &b = vertices[ids[triangles[t * 3 + 1]]].pos;
+                    const amal::vec3 &c = vertices[ids[triangles[t * 3 + 2]]].pos;
+                    return safe_normalize(amal::cross(b - a, c - a));
+                };
+                amal::vec3 axis(0.0f);
+                u32 normal_count = 0;
+                for (u32 t = 0; t < meshlet.triangle_count; ++t)
+                {
+                    const amal::vec3 normal = triangle_normal(t);
+                    if (amal::dot(normal, normal) == 0.0f) continue;
+                    axis += normal;
+                    ++normal_count;
+                }
+                meshlet.cone_axis = safe_normalize(axis);
+                meshlet.cone_cutoff = 1.0f;
+                if (normal_count == 0 || amal::dot(meshlet.cone_axis, meshlet.cone_axis) == 0.0f) return;
+
+                f32 min_dot = 1.0f;
+                for (u32 t = 0; t < meshlet.triangle_count; ++t)
+                {
+                    const amal::vec3 normal = triangle_normal(t);
+                    if (amal::dot(normal, normal) == 0.0f) continue;
+                    min_dot = amal::min(min_dot, amal::dot(normal, meshlet.cone_axis));
+                }
+                if (min_dot > 0.0f) meshlet.cone_cutoff = amal::sqrt(1.0f - min_dot * min_dot);
+            }
+
+            static void build_meshlets(const acul::vector<Vertex> &vertices, const acul::vector<u32> &indices,
+                                       Meshlets &dst, u32 max_vertices, u32 max_triangles)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                constexpr size_t chunk_triangles = 8192;
+                if (max_vertices < 3 || max_vertices > 256 || max_triangles == 0)
+                    throw acul::runtime_error(acul::format("Invalid meshlet limits: %u vertices, %u triangles",
+                                                           max_vertices, max_triangles));
+                const size_t triangle_count = indices.size() / 3;
+                const size_t chunk_count = (triangle_count + chunk_triangles - 1) / chunk_triangles;
+
+                acul::vector<MeshletChunk> chunks(chunk_count);
+                oneapi::tbb::parallel_for(size_t(0), chunk_count, [&](size_t c) {
+                    const size_t last = amal::min(triangle_count, (c + 1) * chunk_triangles);
+                    build_meshlet_chunk(indices, c * chunk_triangles, last, max_vertices, max_triangles, chunks[c]);
+                });
+
+                // Concatenate chunks
+                acul::vector<size_t> meshlet_offsets(chunk_count + 1), vertex_offsets(chunk_count + 1),
+                    triangle_offsets(chunk_count + 1);
+                meshlet_offsets[0] = vertex_offsets[0] = triangle_offsets[0] = 0;
+                for (size_t c = 0; c < chunk_count; ++c)
+                {
+                    meshlet_offsets[c + 1] = meshlet_offsets[c] + chunks[c].meshlets.size();
+                    vertex_offsets[c + 1] = vertex_offsets[c] + chunks[c].vertices.size();
+                    triangle_offsets[c + 1] = triangle_offsets[c] + chunks[c].triangles.size();
+                }
+                dst.meshlets.resize(meshlet_offsets[chunk_count]);
+                dst.vertices.resize(vertex_offsets[chunk_count]);
+                dst.triangles.resize(triangle_offsets[chunk_count]);
+                oneapi::tbb::parallel_for(size_t(0), chunk_count, [&](size_t c) {
+                    const auto &chunk = chunks[c];
+                    for (size_t m = 0; m < chunk.meshlets.size(); ++m)
+                    {
+                        Meshlet meshlet = chunk.meshlets[m];
+                        meshlet.vertex_offset += static_cast<u32>(vertex_offsets[c]);
+                        meshlet.triangle_offset += static_cast<u32>(triangle_offsets[c]);
+                        dst.meshlets[meshlet_offsets[c] + m] = meshlet;
+                    }
+                    std::copy(chunk.vertices.begin(), chunk.vertices.end(), dst.vertices.begin() + vertex_offsets[c]);
+                    std::copy(chunk.triangles.begin(), chunk.triangles.end(),
+                              dst.triangles.begin() + triangle_offsets[c]);
+                });
+
+                oneapi::tbb::parallel_for(range(0, dst.meshlets.size()), [&](const range &r) {
+                    for (size_t m = r.begin(); m < r.end(); ++m) compute_meshlet_bounds(vertices, dst, dst.meshlets[m]);
+                });
+            }
+
+            void build_meshlets(const Model &model, Meshlets &dst, u32 max_vertices, u32 max_triangles)
+            {
+                build_meshlets(model.vertices, model.indices, dst, max_vertices, max_triangles);
+            }
+
+            void build_meshlets(const CompactModel &model, Meshlets &dst, u32 max_vertices, u32 max_triangles)
+            {
+                build_meshlets(model.vertices, model.indices, dst, max_vertices, max_triangles);
+            }
+
+            // Quantized or bitwise attributes of a vertex
+            struct WeldKey
+            {
+                u64 values[8];
+
+                bool operator==(const WeldKey &rhs) const { return memcmp(values, rhs.values, sizeof(values)) == 0; }
+            };
+
+            static inline u64 mix_hash(u64 h)
+            {
+                h ^= h >> 33;
+                h *= 0xFF51AFD7ED558CCDULL;
+                h ^= h >> 33;
+                h *= 0xC4CEB9FE1A85EC53ULL;
+                h ^= h >> 33;
+                return h;
+            }
+
+            // Quantized cells are limited to this magnitude, values outside map to their bit patterns above it
+            static constexpr f64 g_weld_cell_limit = 0x1p62;
+
+            static inline u64 weld_component(f32 value, f32 inv_step)
+            {
+                // Adding zero folds -0.0 into 0.0
+                const f32 canonical = value + 0.0f;
+                u32 bits;
+                memcpy(&bits, &canonical, sizeof(u32));
+                if (inv_step == 0.0f) return bits;
+
+                const f64 cell = std::floor(static_cast<f64>(value) * inv_step + 0.5);
+                if (!(std::fabs(cell) <= g_weld_cell_limit)) return static_cast<u64>(g_weld_cell_limit) + 1 + bits;
+                return static_cast<u64>(static_cast<i64>(cell));
+            }
+
+            static inline f32 inverse_step(f32 step) { return step > 0.0f ? 1.0f / step : 0.0f; }
+
+            static u64 hash_weld_key(const WeldKey &key)
+            {
+                u64 h = 0;
+                for (u64 value : key.values) h = mix_hash(h ^ value);
+                return h;
+            }
+
+            /**
+             * Partitioned open-addressing deduplication. Items are split by the high hash bits with a stable
+             * parallel counting sort, then each partition fills its own table in parallel. `remap[i]` receives
+             * the unique id of item `i`, `firsts[id]` the first item with this id. Ids follow first occurrence.
+             */
+            template <typename Key>
+            static u32 weld_keys(const acul::vector<Key> &keys, const acul::vector<u64> &hashes,
+                                 acul::vector<u32> &remap, acul::vector<u32> &firsts)
+            {
+                constexpr size_t chunk_size = 16384;
+                constexpr u32 empty = UINT32_MAX;
+                const size_t count = keys.size();
+
+                u32 partition_bits = 0;
+                while (partition_bits < 10 && (count >> (partition_bits + 14)) > 0) ++partition_bits;
+                const size_t partition_count = size_t(1) << partition_bits;
+                auto partition_of = [&](size_t i) -> size_t {
+                    return partition_bits ? static_cast<size_t>(hashes[i] >> (64 - partition_bits)) : 0;
+                };
+
+                const size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+                acul::vector<u32> histogram(chunk_count * partition_count, 0);
+                oneapi::tbb::parallel_for(size_t(0), chunk_count, [&](size_t c) {
+                    const size_t last = amal::min(count, (c + 1) * chunk_size);
+                    for (size_t i = c * chunk_size; i < last; ++i) ++histogram[c * partition_count + partition_of(i)];
+                });
+
+                acul::vector<u32> partition_offsets(partition_count + 1);
+                u32 running = 0;
+                for (size_t p = 0; p < partition_count; ++p)
+                {
+                    partition_offsets[p] = running;
+                    for (size_t c = 0; c < chunk_count; ++c)
+                    {
+                        const u32 items = histogram[c * partition_count + p];
+                        histogram[c * partition_count + p] = running;
+                        running += items;
+                    }
+                }
+                partition_offsets[partition_count] = running;
+
+                acul::vector<u32> items(count);
+                oneapi::tbb::parallel_for(size_t(0), chunk_count, [&](size_t c) {
+                    const size_t last = amal::min(count, (c + 1) * chunk_size);
+                    for (size_t i = c * chunk_size; i < last; ++i)
+                        items[histogram[c * partition_count + partition_of(i)]++] = static_cast<u32>(i);
+                });
+
+                acul::vector<u32> representatives(count);
+                oneapi::tbb::parallel_for(size_t(0), partition_count, [&](size_t p) {
+                    const u32 first = partition_offsets[p], last = partition_offsets[p + 1];
+                    size_t capacity = 16;
+                    while (capacity < (last - first) * 2ULL) capacity <<= 1;
+                    const size_t mask = capacity - 1;
+                    acul::vector<u32> table(capacity, empty);
+                    for (u32 j = first; j < last; ++j)
+                    {
+                        const u32 item = items[j];
+                        size_t slot = static_cast<size_t>(hashes[item]) & mask;
+                        while (true)
+                        {
+                            const u32 stored = table[slot];
+                            if (stored == empty)
+                            {
+                                table[slot] = item;
+                                representatives[item] = item;
+                                break;
+                            }
+                            if (hashes[stored] == hashes[item] && keys[stored] == keys[item])
+                            {
+                                representatives[item] = stored;
+                                break;
+                            }
+                            slot = (slot + 1) & mask;
+                        }
+                    }
+                });
+
+                // Items inside a partition are visited in source order, so representatives precede their copies
+                remap.resize(count);
+                firsts.clear();
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (representatives[i] == i)
+                    {
+                        remap[i] = static_cast<u32>(firsts.size());
+                        firsts.push_back(static_cast<u32>(i));
+                    }
+                    else
+                        remap[i] = remap[representatives[i]];
+                }
+                return static_cast<u32>(firsts.size());
+            }
+
+            static u32 weld_vertex_ids(const acul::vector<Vertex> &vertices, const WeldOptions &options,
+                                       acul::vector<u32> &remap, acul::vector<u32> &firsts)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                acul::vector<u64> hashes(vertices.size());
+                if (options.mode == WeldMode::exact)
+                {
+                    acul::vector<Vertex> keys(vertices.size());
+                    oneapi::tbb::parallel_for(range(0, vertices.size()), [&](const range &r) {
+                        for (size_t i = r.begin(); i < r.end(); ++i)
+                        {
+                            // Folds -0.0 into 0.0 so that equal vertices hash equally
+                            const Vertex &src = vertices[i];
+                            keys[i].pos = src.pos + amal::vec3(0.0f);
+                            keys[i].uv = src.uv + amal::vec2(0.0f);
+                            keys[i].normal = src.normal + amal::vec3(0.0f);
+                            hashes[i] = mix_hash(std::hash<Vertex>{}(keys[i]));
+                        }
+                    });
+                    return weld_keys(keys, hashes, remap, firsts);
+                }
+
+                const f32 pos_step = inverse_step(options.position_epsilon);
+                const f32 uv_step = inverse_step(options.uv_epsilon);
+                const f32 normal_step = inverse_step(options.normal_epsilon);
+                acul::vector<WeldKey> keys(vertices.size());
+                oneapi::tbb::parallel_for(range(0, vertices.size()), [&](const range &r) {
+                    for (size_t i = r.begin(); i < r.end(); ++i)
+                    {
+                        const Vertex &src = vertices[i];
+                        auto &values = keys[i].values;
+                        for (int c = 0; c < 3; ++c) values[c] = weld_component(src.pos[c], pos_step);
+                        for (int c = 0; c < 2; ++c) values[3 + c] = weld_component(src.uv[c], uv_step);
+                        for (int c = 0; c < 3; ++c) values[5 + c] = weld_component(src.normal[c], normal_step);
+                        hashes[i] = hash_weld_key(keys[i]);
+                    }
+                });
+                return weld_keys(keys, hashes, remap, firsts);
+            }
+
+            static u32 weld_position_ids(const acul::vector<Vertex> &vertices, const WeldOptions &options,
+                                         acul::vector<u32> &remap)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                const f32 pos_step = options.mode == WeldMode::exact ? 0.0f : inverse_step(options.position_epsilon);
+                acul::vector<WeldKey> keys(vertices.size());
+                acul::vector<u64> hashes(vertices.size());
+                oneapi::tbb::parallel_for(range(0, vertices.size()), [&](const range &r) {
+                    for (size_t i = r.begin(); i < r.end(); ++i)
+                    {
+                        keys[i] = {};
+                        for (int c = 0; c < 3; ++c) keys[i].values[c] = weld_component(vertices[i].pos[c], pos_step);
+                        hashes[i] = hash_weld_key(keys[i]);
+                    }
+                });
+                acul::vector<u32> firsts;
+                return weld_keys(keys, hashes, remap, firsts);
+            }
+
+            void weld_triangle_soup(const acul::vector<Vertex> &soup, Model &dst, const WeldOptions &options)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                acul::vector<Vertex> corners(soup.begin(), soup.begin() + (soup.size() - soup.size() % 3));
+                const size_t triangle_count = corners.size() / 3;
+
+                acul::vector<u32> vertex_ids, group_ids, firsts;
+                weld_vertex_ids(corners, options, vertex_ids, firsts);
+                dst.group_count = weld_position_ids(corners, options, group_ids);
+
+                dst.vertices.resize(firsts.size());
+                oneapi::tbb::parallel_for(range(0, firsts.size()), [&](const range &r) {
+                    for (size_t v = r.begin(); v < r.end(); ++v) dst.vertices[v] = corners[firsts[v]];
+                });
+
+                dst.faces.resize(triangle_count);
+                oneapi::tbb::parallel_for(range(0, triangle_count), [&](const range &r) {
+                    for (size_t t = r.begin(); t < r.end(); ++t)
+                    {
+                        auto &face = dst.faces[t];
+                        face.vertices.resize(3);
+                        for (u32 k = 0; k < 3; ++k) face.vertices[k] = {group_ids[t * 3 + k], vertex_ids[t * 3 + k]};
+                        const amal::vec3 normal = amal::cross(corners[t * 3 + 1].pos - corners[t * 3].pos,
+                                                              corners[t * 3 + 2].pos - corners[t * 3].pos);
+                        const f32 length = amal::sqrt(amal::dot(normal, normal));
+                        face.normal = length > 0.0f ? normal / length : amal::vec3(0.0f);
+                        face.first_vertex = static_cast<u32>(t * 3);
+                        face.count = 3;
+                    }
+                });
+                dst.indices = std::move(vertex_ids);
+
+                dst.aabb = compute_aabb(dst.vertices);
+            }
+
+            u32 weld_vertices(Model &model, const WeldOptions &options)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                acul::vector<u32> remap, firsts;
+                const u32 vertex_count = weld_vertex_ids(model.vertices, options, remap, firsts);
+                if (vertex_count == model.vertices.size()) return vertex_count;
+
+                acul::vector<Vertex> vertices(vertex_count);
+                oneapi::tbb::parallel_for(range(0, vertex_count), [&](const range &r) {
+                    for (size_t v = r.begin(); v < r.end(); ++v) vertices[v] = model.vertices[firsts[v]];
+                });
+                model.vertices = std::move(vertices);
+                oneapi::tbb::parallel_for(range(0, model.indices.size()), [&](const range &r) {
+                    for (size_t i = r.begin(); i < r.end(); ++i) model.indices[i] = remap[model.indices[i]];
+                });
+                oneapi::tbb::parallel_for(range(0, model.faces.size()), [&](const range &r) {
+                    for (size_t f = r.begin(); f < r.end(); ++f)
+                        for (auto &ref : model.faces[f].vertices) ref.vertex = remap[ref.vertex];
+                });
+                return vertex_count;
+            }
+
+            namespace
+            {
+                // Mesh block found in the meta of an object
+                struct MeshEntry
+                {
+                    u32 object;
+                    u32 block;
+                    u64 hash;
+                };
+
+                struct InstanceSource
+                {
+                    acul::shared_ptr<Mesh> mesh;
+                    u64 id;
+                };
+
+                u64 hash_words(u64 h, const void *data, size_t size)
+                {
+                    const u8 *bytes = static_cast<const u8 *>(data);
+                    for (size_t offset = 0; offset + sizeof(u32) <= size; offset += sizeof(u32))
+                    {
+                        u32 word;
+                        memcpy(&word, bytes + offset, sizeof(u32));
+                        h = mix_hash(h ^ word);
+                    }
+                    return mix_hash(h ^ size);
+                }
+
+                u64 hash_model(const Model &model)
+                {
+                    static_assert(sizeof(Vertex) % sizeof(u32) == 0, "Vertex must consist of 32-bit words");
+                    u64 h = hash_words(0, model.vertices.data(), model.vertices.size() * sizeof(Vertex));
+                    h = hash_words(h, model.indices.data(), model.indices.size() * sizeof(u32));
+                    h = mix_hash(h ^ model.group_count);
+                    for (const auto &face : model.faces)
+                    {
+                        h = hash_words(h, face.vertices.data(), face.vertices.size() * sizeof(VertexRef));
+                        h = hash_words(h, &face.normal, sizeof(face.normal));
+                        h = mix_hash(h ^ (static_cast<u64>(face.first_vertex) << 32 | face.count));
+                    }
+                    return h;
+                }
+
+                bool same_model(const Model &a, const Model &b)
+                {
+                    if (a.group_count != b.group_count || a.vertices.size() != b.vertices.size() ||
+                        a.indices.size() != b.indices.size() || a.faces.size() != b.faces.size())
+                        return false;
+                    if (memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(Vertex)) != 0 ||
+                        memcmp(a.indices.data(), b.indices.data(), a.indices.size() * sizeof(u32)) != 0 ||
+                        memcmp(&a.aabb, &b.aabb, sizeof(AABB)) != 0)
+                        return false;
+                    for (size_t f = 0; f < a.faces.size(); ++f)
+                    {
+                        const Face &fa = a.faces[f];
+                        const Face &fb = b.faces[f];
+                        if (fa.first_vertex != fb.first_vertex || fa.count != fb.count ||
+                            fa.vertices.size() != fb.vertices.size() ||
+                            memcmp(&fa.normal, &fb.normal, sizeof(fa.normal)) != 0 ||
+                            memcmp(fa.vertices.data(), fb.vertices.data(), fa.vertices.size() * sizeof(VertexRef)) != 0)
+                            return false;
+                    }
+                    return true;
+                }
+            } // namespace
+
+            u32 instance_meshes(Scene &scene)
+            {
+                acul::vector<MeshEntry> entries;
+                for (u32 o = 0; o < scene.objects.size(); ++o)
+                {
+                    const auto &meta = scene.objects[o].meta;
+                    for (u32 b = 0; b < meta.size(); ++b)
+                        if (meta[b] && meta[b]->signature() == sign_block::mesh)
+                        {
+                            entries.push_back({o, b, 0});
+                            break;
+                        }
+                }
+
+                oneapi::tbb::parallel_for(size_t(0), entries.size(), [&](size_t i) {
+                    auto &entry = entries[i];
+                    const auto &block = scene.objects[entry.object].meta[entry.block];
+                    entry.hash = hash_model(static_cast<const Mesh *>(block.get())->model);
+                });
+                std::stable_sort(entries.begin(), entries.end(),
+                                 [](const MeshEntry &a, const MeshEntry &b) { return a.hash < b.hash; });
+
+                // Within a run of equal hashes the first object of every distinct model becomes the source
+                u32 instanced = 0;
+                acul::vector<InstanceSource> sources;
+                for (size_t begin = 0; begin < entries.size();)
+                {
+                    size_t end = begin + 1;
+                    while (end < entries.size() && entries[end].hash == entries[begin].hash) ++end;
+                    sources.clear();
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        auto &object = scene.objects[entries[i].object];
+                        auto &block = object.meta[entries[i].block];
+                        auto mesh = acul::static_pointer_cast<Mesh>(block);
+                        const InstanceSource *source = nullptr;
+                        for (const auto &candidate : sources)
+                            if (candidate.mesh->encoding == mesh->encoding &&
+                                same_model(candidate.mesh->model, mesh->model))
+                            {
+                                source = &candidate;
+                                break;
+                            }
+                        if (!source)
+                        {
+                            sources.push_back({mesh, object.id});
+                            continue;
+                        }
+
+                        auto instance = acul::make_shared<Instance>();
+                        instance->source = source->id;
+                        instance->transform = mesh->transform;
+                        instance->mesh = source->mesh;
+                        block = instance;
+                        ++instanced;
+                    }
+                    begin = end;
+                }
+                if (instanced > 0) scene.invalidate_lookup();
+                return instanced;
+            }
+
+            namespace
+            {
+                u32 vertex_format_components(VertexFormat::enum_type format)
+                {
+                    switch (format)
+                    {
+                        case VertexFormat::f32x1:
+                            return 1;
+                        case VertexFormat::f32x2:
+                        case VertexFormat::f16x2:
+                            return 2;
+                        case VertexFormat::f32x3:
+                            return 3;
+                        default:
+                            return 4;
+                    }
+                }
+
+                void encode_vertex_element(VertexFormat::enum_type format, const amal::vec4 &value, u8 *dst)
+                {
+                    const u32 components = vertex_format_components(format);
+                    switch (format)
+                    {
+                        case VertexFormat::f16x2:
+                        case VertexFormat::f16x4:
+                            for (u32 c = 0; c < components; ++c)
+                            {
+                                const f16 half(value[c]);
+                                memcpy(dst + c * sizeof(f16), &half, sizeof(f16));
+                            }
+                            break;
+                        case VertexFormat::unorm8x4:
+                            for (u32 c = 0; c < components; ++c)
+                                dst[c] = static_cast<u8>(amal::clamp(value[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+                            break;
+                        default:
+                            memcpy(dst, &value.x, components * sizeof(f32));
+                            break;
+                    }
+                }
+
+                amal::vec4 decode_vertex_element(VertexFormat::enum_type format, const u8 *src)
+                {
+                    amal::vec4 value(0.0f, 0.0f, 0.0f, 1.0f);
+                    const u32 components = vertex_format_components(format);
+                    switch (format)
+                    {
+                        case VertexFormat::f16x2:
+                        case VertexFormat::f16x4:
+                            for (u32 c = 0; c < components; ++c)
+                            {
+                                f16 half;
+                                memcpy(&half, src + c * sizeof(f16), sizeof(f16));
+                                value[c] = static_cast<f32>(half);
+                            }
+                            break;
+                        case VertexFormat::unorm8x4:
+                            for (u32 c = 0; c < components; ++c) value[c] = src[c] / 255.0f;
+                            break;
+                        default:
+                            memcpy(&value.x, src, components * sizeof(f32));
+                            break;
+                    }
+                    return value;
+                }
+            } // namespace
+
+            bool add_vertex_stream(VertexAttributes &dst, VertexAttribute::enum_type attribute,
+                                   VertexFormat::enum_type format, const acul::vector<amal::vec4> &values)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                const u32 size = vertex_format_size(format);
+                if (size == 0 || dst.find(attribute)) return false;
+                if (dst.streams.empty()) dst.vertex_count = static_cast<u32>(values.size());
+                if (values.size() != dst.vertex_count) return false;
+
+                VertexStream stream;
+                stream.elements.push_back({attribute, format, 0});
+                stream.stride = size;
+                stream.data.resize(values.size() * size);
+                oneapi::tbb::parallel_for(range(0, values.size()), [&](const range &r) {
+                    for (size_t i = r.begin(); i < r.end(); ++i)
+                        encode_vertex_element(format, values[i], stream.data.data() + i * size);
+                });
+                dst.streams.push_back(std::move(stream));
+                return true;
+            }
+
+            bool read_vertex_attribute(const VertexAttributes &src, VertexAttribute::enum_type attribute,
+                                       acul::vector<amal::vec4> &dst)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                const VertexElement *element = nullptr;
+                const VertexStream *stream = src.find(attribute, &element);
+                if (!stream) return false;
+
+                dst.resize(src.vertex_count);
+                oneapi::tbb::parallel_for(range(0, dst.size()), [&](const range &r) {
+                    for (size_t i = r.begin(); i < r.end(); ++i)
+                        dst[i] = decode_vertex_element(element->format,
+                                                       stream->data.data() + i * stream->stride + element->offset);
+                });
+                return true;
+            }
+
+            void interleave_vertex_streams(VertexAttributes &attributes)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                if (attributes.streams.size() < 2) return;
+
+                VertexStream interleaved;
+                acul::vector<u32> offsets;
+                for (const auto &stream : attributes.streams)
+                {
+                    offsets.push_back(interleaved.stride);
+                    for (auto element : stream.elements)
+                    {
+                        element.offset = static_cast<u16>(element.offset + interleaved.stride);
+                        interleaved.elements.push_back(element);
+                    }
+                    interleaved.stride += stream.stride;
+                }
+                interleaved.data.resize(static_cast<size_t>(attributes.vertex_count) * interleaved.stride);
+                oneapi::tbb::parallel_for(range(0, attributes.vertex_count), [&](const range &r) {
+                    for (size_t i = r.begin(); i < r.end(); ++i)
+                        for (size_t s = 0; s < attributes.streams.size(); ++s)
+                        {
+                            const auto &stream = attributes.streams[s];
+                            memcpy(interleaved.data.data() + i * interleaved.stride + offsets[s],
+                                   stream.data.data() + i * stream.stride, stream.stride);
+                        }
+                });
+                attributes.streams.clear();
+                attributes.streams.push_back(std::move(interleaved));
+            }
+
+            void to_compact_model(const Model &src, CompactModel &dst)
+            {
+                dst.vertices = src.vertices;
+                dst.group_count = src.group_count;
+                fill_face_table(src.faces, dst.faces);
+                dst.indices = src.indices;
+                dst.aabb = src.aabb;
+            }
+
+            void to_model(const CompactModel &src, Model &dst)
+            {
+                dst.vertices = src.vertices;
+                dst.group_count = src.group_count;
+                expand_face_table(src.faces, dst.faces);
+                dst.indices = src.indices;
+                dst.aabb = src.aabb;
+            }
+
+            namespace
+            {
+                // Sum of squared distances to a set of planes
+                struct Quadric
+                {
+                    f64 a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+                    f64 b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+
+                    void add_plane(const amal::vec3 &n, f32 d)
+                    {
+                        a00 += n.x * n.x;
+                        a01 += n.x * n.y;
+                        a02 += n.x * n.z;
+                        a11 += n.y * n.y;
+                        a12 += n.y * n.z;
+                        a22 += n.z * n.z;
+                        b0 += n.x * d;
+                        b1 += n.y * d;
+                        b2 += n.z * d;
+                        c += static_cast<f64>(d) * d;
+                    }
+
+                    Quadric &operator+=(const Quadric &rhs)
+                    {
+                        a00 += rhs.a00;
+                        a01 += rhs.a01;
+                        a02 += rhs.a02;
+                        a11 += rhs.a11;
+                        a12 += rhs.a12;
+                        a22 += rhs.a22;
+                        b0 += rhs.b0;
+                        b1 += rhs.b1;
+                        b2 += rhs.b2;
+                        c += rhs.c;
+                        return *this;
+                    }
+
+                    f64 error(const amal::vec3 &p) const
+                    {
+                        const f64 x = p.x, y = p.y, z = p.z;
+                        const f64 r = a00 * x * x + a11 * y * y + a22 * z * z +
+                                      2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                                      2.0 * (b0 * x + b1 * y + b2 * z) + c;
+                        return r > 0.0 ? r : 0.0;
+                    }
+                };
+
+                struct CollapseCandidate
+                {
+                    f64 cost;
+                    u32 from;
+                    u32 to;
+
+                    bool operator<(const CollapseCandidate &rhs) const
+                    {
+                        if (cost != rhs.cost) return cost < rhs.cost;
+                        if (from != rhs.from) return from < rhs.from;
+                        return to < rhs.to;
+                    }
+                };
+            } // namespace
+
+            static constexpr u32 g_no_material = UINT32_MAX - 1;
+
+            // Material index of every triangle, `g_no_material` for unassigned triangles
+            static void fill_triangle_materials(const Model &model,
+                                                const acul::vector<acul::shared_ptr<MaterialRange>> &materials,
+                                                size_t triangle_count, acul::vector<u32> &dst)
+            {
+                dst = acul::vector<u32>(triangle_count, g_no_material);
+                for (size_t m = 0; m < materials.size(); ++m)
+                {
+                    if (!materials[m]) continue;
+                    for (u32 f : materials[m]->faces)
+                    {
+                        if (f >= model.faces.size() || model.faces[f].count == 0) continue;
+                        const auto &face = model.faces[f];
+                        const size_t last = amal::min(triangle_count, (face.first_vertex + face.count + size_t(2)) / 3);
+                        for (size_t t = face.first_vertex / 3; t < last; ++t) dst[t] = static_cast<u32>(m);
+                    }
+                }
+            }
+
+            // Locks vertices on UV/normal seams, open or non-manifold borders and material boundaries
+            static void lock_vertices(const Model &model, const acul::vector<u32> &indices,
+                                      const acul::vector<u32> &triangle_materials, acul::vector<u8> &locked)
+            {
+                const size_t vertex_count = model.vertices.size();
+                acul::vector<u32> groups;
+                const u32 group_count = weld_position_ids(model.vertices, WeldOptions{}, groups);
+                acul::vector<u8> group_locked(group_count, 0);
+
+                // Seams: several used vertices share one position
+                acul::vector<u32> group_vertex(group_count, UINT32_MAX);
+                for (u32 index : indices)
+                {
+                    u32 &first = group_vertex[groups[index]];
+                    if (first == UINT32_MAX)
+                        first = index;
+                    else if (first != index)
+                        group_locked[groups[index]] = 1;
+                }
+
+                // Borders: position edges not shared by exactly two triangles
+                const size_t triangle_count = indices.size() / 3;
+                acul::vector<u64> edges;
+                edges.reserve(indices.size());
+                for (size_t t = 0; t < triangle_count; ++t)
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        const u32 a = groups[indices[t * 3 + k]], b = groups[indices[t * 3 + (k + 1) % 3]];
+                        if (a != b) edges.push_back((static_cast<u64>(amal::min(a, b)) << 32) | amal::max(a, b));
+                    }
+                std::sort(edges.begin(), edges.end());
+                for (size_t i = 0; i < edges.size();)
+                {
+                    size_t j = i + 1;
+                    while (j < edges.size() && edges[j] == edges[i]) ++j;
+                    if (j - i != 2) group_locked[edges[i] >> 32] = group_locked[static_cast<u32>(edges[i])] = 1;
+                    i = j;
+                }
+
+                // Material boundaries
+                acul::vector<u32> group_material(group_count, UINT32_MAX);
+                for (size_t t = 0; t < triangle_count; ++t)
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        u32 &material = group_material[groups[indices[t * 3 + k]]];
+                        if (material == UINT32_MAX)
+                            material = triangle_materials[t];
+                        else if (material != triangle_materials[t])
+                            group_locked[groups[indices[t * 3 + k]]] = 1;
+                    }
+
+                locked.resize(vertex_count);
+                for (size_t v = 0; v < vertex_count; ++v) locked[v] = group_locked[groups[v]];
+            }
+
+            // Returns true if moving `from` onto `to` flips a triangle that survives the collapse
+            static bool collapse_flips(const acul::vector<Vertex> &vertices, const acul::vector<u32> &indices,
+                                       const u32 *triangles, u32 triangle_count, u32 from, u32 to)
+            {
+                for (u32 i = 0; i < triangle_count; ++i)
+                {
+                    const u32 *triangle = indices.data() + triangles[i] * 3ULL;
+                    if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+                    amal::vec3 p[3];
+                    for (int k = 0; k < 3; ++k) p[k] = vertices[triangle[k]].pos;
+                    const amal::vec3 before = amal::cross(p[1] - p[0], p[2] - p[0]);
+                    for (int k = 0; k < 3; ++k)
+                        if (triangle[k] == from) p[k] = vertices[to].pos;
+                    const amal::vec3 after = amal::cross(p[1] - p[0], p[2] - p[0]);
+                    if (amal::dot(before, after) <= 0.0f) return true;
+                }
+                return false;
+            }
+
+            /**
+             * Collapses edges in passes until the index count reaches the target or no collapse is cheaper than
+             * `max_cost`. Every pass sorts candidates by cost and applies independent collapses only.
+             * Returns the largest applied cost.
+             */
+            static f64 simplify_triangles(const acul::vector<Vertex> &vertices, const acul::vector<u8> &locked,
+                                          acul::vector<Quadric> &quadrics, acul::vector<u32> &indices,
+                                          size_t target_index_count, f64 max_cost)
+            {
+                const size_t vertex_count = vertices.size();
+                acul::vector<u32> collapse(vertex_count), adjacency_offsets(vertex_count + 1), adjacency;
+                acul::vector<u8> touched(vertex_count);
+                acul::vector<CollapseCandidate> candidates;
+                f64 applied_cost = 0.0;
+                while (indices.size() > target_index_count)
+                {
+                    // Vertex to triangle adjacency
+                    const size_t triangle_count = indices.size() / 3;
+                    std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+                    for (u32 index : indices) ++adjacency_offsets[index + 1];
+                    for (size_t v = 0; v < vertex_count; ++v) adjacency_offsets[v + 1] += adjacency_offsets[v];
+                    adjacency.resize(indices.size());
+                    acul::vector<u32> cursors(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+                    for (size_t i = 0; i < indices.size(); ++i)
+                        adjacency[cursors[indices[i]]++] = static_cast<u32>(i / 3);
+
+                    candidates.clear();
+                    for (size_t i = 0; i < indices.size(); ++i)
+                    {
+                        const u32 a = indices[i], b = indices[i - i % 3 + (i + 1) % 3];
+                        if (a == b) continue;
+                        Quadric q = quadrics[a];
+                        q += quadrics[b];
+                        if (!locked[a]) candidates.push_back({q.error(vertices[b].pos), a, b});
+                        if (!locked[b]) candidates.push_back({q.error(vertices[a].pos), b, a});
+                    }
+                    std::sort(candidates.begin(), candidates.end());
+
+                    std::iota(collapse.begin(), collapse.end(), 0);
+                    std::fill(touched.begin(), touched.end(), 0);
+                    size_t removed = 0, collapses = 0;
+                    for (const auto &candidate : candidates)
+                    {
+                        if (candidate.cost > max_cost || indices.size() - removed <= target_index_count) break;
+                        const u32 from = candidate.from, to = candidate.to;
+                        if (touched[from] || touched[to]) continue;
+                        const u32 *triangles = adjacency.data() + adjacency_offsets[from];
+                        const u32 count = adjacency_offsets[from + 1] - adjacency_offsets[from];
+                        if (collapse_flips(vertices, indices, triangles, count, from, to)) continue;
+
+                        // The one-ring of `from` is frozen for the rest of the pass
+                        for (u32 i = 0; i < count; ++i)
+                        {
+                            const u32 *triangle = indices.data() + triangles[i] * 3ULL;
+                            if (triangle[0] == to || triangle[1] == to || triangle[2] == to) removed += 3;
+                            for (int k = 0; k < 3; ++k) touched[triangle[k]] = 1;
+                        }
+                        collapse[from] = to;
+                        quadrics[to] += quadrics[from];
+                        applied_cost = amal::max(applied_cost, candidate.cost);
+                        ++collapses;
+                    }
+                    if (collapses == 0) break;
+
+                    size_t write = 0;
+                    for (size_t t = 0; t < triangle_count; ++t)
+                    {
+                        const u32 a = collapse[indices[t * 3]], b = collapse[indices[t * 3 + 1]],
+                                  c = collapse[indices[t * 3 + 2]];
+                        if (a == b || b == c || a == c) continue;
+                        indices[write++] = a;
+                        indices[write++] = b;
+                        indices[write++] = c;
+                    }
+                    indices.resize(write);
+                }
+                return applied_cost;
+            }
+
+            void build_lod_chain(const Model &model, const acul::vector<acul::shared_ptr<MaterialRange>> &materials,
+                                 LodChain &dst, const LodOptions &options)
+            {
+                acul::vector<u32> indices(model.indices.begin(),
+                                          model.indices.begin() + (model.indices.size() - model.indices.size() % 3));
+                dst.levels.clear();
+                dst.levels.push_back({0, static_cast<u32>(indices.size()), 0.0f});
+                dst.indices = indices;
+
+                const AABB box = compute_aabb(model.vertices);
+                const f32 extent = amal::sqrt(amal::dot(box.max - box.min, box.max - box.min));
+                if (options.max_levels < 2 || indices.empty() || extent == 0.0f) return;
+
+                const size_t triangle_count = indices.size() / 3;
+                acul::vector<u32> triangle_materials;
+                acul::vector<u8> locked;
+                fill_triangle_materials(model, materials, triangle_count, triangle_materials);
+                lock_vertices(model, indices, triangle_materials, locked);
+
+                acul::vector<Quadric> quadrics(model.vertices.size());
+                for (size_t t = 0; t < triangle_count; ++t)
+                {
+                    const u32 *triangle = indices.data() + t * 3;
+                    const amal::vec3 &p0 = model.vertices[triangle[0]].pos;
+                    const amal::vec3 normal = safe_normalize(amal::cross(model.vertices[triangle[1]].pos - p0,
+                                                                         model.vertices[triangle[2]].pos - p0));
+                    Quadric plane;
+                    plane.add_plane(normal, -amal::dot(normal, p0));
+                    for (int k = 0; k < 3; ++k) quadrics[triangle[k]] += plane;
+                }
+
+                const f64 max_distance = static_cast<f64>(options.max_error) * extent;
+                f32 error = 0.0f;
+                for (u32 level = 1; level < options.max_levels; ++level)
+                {
+                    const size_t source_count = indices.size();
+                    const size_t target = static_cast<size_t>(source_count / 3 * options.reduction) * 3;
+                    const f64 cost = simplify_triangles(model.vertices, locked, quadrics, indices, target,
+                                                        max_distance * max_distance);
+                    if (indices.size() >= source_count || indices.empty()) break;
+                    error = amal::max(error, static_cast<f32>(std::sqrt(cost) / extent));
+                    dst.levels.push_back(
+                        {static_cast<u32>(dst.indices.size()), static_cast<u32>(indices.size()), error});
+                    dst.indices.insert(dst.indices.end(), indices.begin(), indices.end());
+                }
+            }
+
+            void build_lod_chains(Scene &scene, const LodOptions &options)
+            {
+                oneapi::tbb::parallel_for(size_t(0), scene.objects.size(), [&](size_t i) {
+                    auto &meta = scene.objects[i].meta;
+                    const Mesh *mesh = nullptr;
+                    acul::vector<acul::shared_ptr<MaterialRange>> materials;
+                    size_t chain_index = meta.size();
+                    for (size_t b = 0; b < meta.size(); ++b)
+                    {
+                        if (!meta[b]) continue;
+                        const u32 signature = meta[b]->signature();
+                        if (signature == sign_block::mesh)
+                            mesh = static_cast<const Mesh *>(meta[b].get());
+                        else if (signature == sign_block::material_range)
+                            materials.push_back(acul::static_pointer_cast<MaterialRange>(meta[b]));
+                        else if (signature == sign_block::lod_chain)
+                            chain_index = b;
+                    }
+                    if (!mesh) return;
+
+                    auto chain = acul::make_shared<LodChain>();
+                    build_lod_chain(mesh->model, materials, *chain, options);
+                    if (chain_index < meta.size())
+                        meta[chain_index] = chain;
+                    else
+                        meta.push_back(chain);
+                });
+                scene.invalidate_lookup();
+            }
+
+            bool build_draw_ranges(Model &model, const acul::vector<acul::shared_ptr<MaterialRange>> &materials,
+                                   u64 default_id, DrawRanges &dst)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                constexpr size_t chunk_size = 4096;
+                const size_t face_count = model.faces.size();
+                const size_t index_count = model.indices.size();
+
+                // Slot 0 holds the default material, assignments with equal ids share a slot
+                acul::vector<u64> slot_materials{default_id};
+                acul::hashmap<u64, u32> material_slots;
+                material_slots.emplace(default_id, 0);
+                acul::vector<u32> slots(face_count, 0);
+                for (const auto &material : materials)
+                {
+                    if (!material) continue;
+                    auto [it, inserted] = material_slots.emplace(material->mat_id, slot_materials.size());
+                    if (inserted) slot_materials.push_back(material->mat_id);
+                    const u32 slot = it->second;
+                    const auto &faces = material->faces;
+                    oneapi::tbb::parallel_for(range(0, faces.size()), [&](const range &r) {
+                        for (size_t i = r.begin(); i < r.end(); ++i)
+                            if (faces[i] < face_count) slots[faces[i]] = slot;
+                    });
+                }
+
+                // Index counts per chunk and slot
+                const size_t slot_count = slot_materials.size();
+                const size_t chunk_count = (face_count + chunk_size - 1) / chunk_size;
+                acul::vector<u64> counts(chunk_count * slot_count, 0);
+                std::atomic<bool> valid{true};
+                oneapi::tbb::parallel_for(size_t(0), chunk_count, [&](size_t c) {
+                    u64 *chunk_counts = counts.data() + c * slot_count;
+                    const size_t last = amal::min(face_count, (c + 1) * chunk_size);
+                    for (size_t f = c * chunk_size; f < last; ++f)
+                    {
+                        const Face &face = model.faces[f];
+                        if (face.first_vertex + static_cast<u64>(face.count) > index_count)
+                            valid.store(false, std::memory_order_relaxed);
+                        chunk_counts[slots[f]] += face.count;
+                    }
+                });
+                if (!valid.load()) return false;
+
+                // Sorted by first index, the faces must tile the index buffer without gaps or overlaps
+                acul::vector<u32> order(face_count);
+                std::iota(order.begin(), order.end(), 0u);
+                oneapi::tbb::parallel_sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+                    const Face &fa = model.faces[a], &fb = model.faces[b];
+                    return fa.first_vertex != fb.first_vertex ? fa.first_vertex < fb.first_vertex : fa.count < fb.count;
+                });
+                oneapi::tbb::parallel_for(range(0, face_count), [&](const range &r) {
+                    for (size_t k = r.begin(); k < r.end(); ++k)
+                    {
+                        const Face &face = model.faces[order[k]];
+                        const u64 expected = k == 0 ? 0
+                                                    : model.faces[order[k - 1]].first_vertex +
+                                                          static_cast<u64>(model.faces[order[k - 1]].count);
+                        if (face.first_vertex != expected) valid.store(false, std::memory_order_relaxed);
+                    }
+                });
+                const u64 covered = face_count == 0 ? 0
+                                                    : model.faces[order.back()].first_vertex +
+                                                          static_cast<u64>(model.faces[order.back()].count);
+                if (!valid.load() || covered != index_count) return false;
+
+                // Exclusive prefix sum in slot-major order gives every chunk its write cursor per slot
+                acul::vector<DrawRange> ranges;
+                u64 offset = 0;
+                for (size_t slot = 0; slot < slot_count; ++slot)
+                {
+                    const u64 first = offset;
+                    for (size_t c = 0; c < chunk_count; ++c)
+                    {
+                        const u64 count = counts[c * slot_count + slot];
+                        counts[c * slot_count + slot] = offset;
+                        offset += count;
+                    }
+                    if (offset == first) continue;
+                    ranges.push_back(
+                        {slot_materials[slot], static_cast<u32>(first), static_cast<u32>(offset - first)});
+                }
+
+                acul::vector<u32> indices(index_count);
+                oneapi::tbb::parallel_for(size_t(0), chunk_count, [&](size_t c) {
+                    u64 *cursors = counts.data() + c * slot_count;
+                    const size_t last = amal::min(face_count, (c + 1) * chunk_size);
+                    for (size_t f = c * chunk_size; f < last; ++f)
+                    {
+                        Face &face = model.faces[f];
+                        u64 &cursor = cursors[slots[f]];
+                        std::copy_n(model.indices.begin() + face.first_vertex, face.count, indices.begin() + cursor);
+                        face.first_vertex = static_cast<u32>(cursor);
+                        cursor += face.count;
+                    }
+                });
+                model.indices = std::move(indices);
+                dst.ranges = std::move(ranges);
+                return true;
+            }
+
+            namespace
+            {
+                // Objects that reference the same `Mesh` block, objects holding it come before instances
+                struct MeshOwners
+                {
+                    Mesh *mesh;
+                    acul::vector<size_t> objects;
+                };
+
+                acul::vector<MeshOwners> collect_mesh_owners(Scene &scene)
+                {
+                    acul::vector<MeshOwners> owners;
+                    acul::hashmap<Mesh *, size_t> owner_index;
+                    acul::hashmap<u64, Mesh *> source_meshes;
+                    for (size_t i = 0; i < scene.objects.size(); ++i)
+                    {
+                        Mesh *mesh = nullptr;
+                        for (const auto &block : scene.objects[i].meta)
+                        {
+                            if (!block || block->signature() != sign_block::mesh) continue;
+                            mesh = static_cast<Mesh *>(block.get());
+                            break;
+                        }
+                        if (!mesh) continue;
+                        auto [it, inserted] = owner_index.emplace(mesh, owners.size());
+                        if (inserted) owners.push_back({mesh, {}});
+                        owners[it->second].objects.push_back(i);
+                        source_meshes.emplace(scene.objects[i].id, mesh);
+                    }
+
+                    // Unresolved instances are matched by the id of their source object
+                    for (size_t i = 0; i < scene.objects.size(); ++i)
+                        for (const auto &block : scene.objects[i].meta)
+                        {
+                            if (!block || block->signature() != sign_block::mesh_instance) continue;
+                            const auto *instance = static_cast<const Instance *>(block.get());
+                            Mesh *mesh = instance->mesh.get();
+                            if (!mesh)
+                            {
+                                auto source = source_meshes.find(instance->source);
+                                if (source != source_meshes.end()) mesh = source->second;
+                            }
+                            auto it = owner_index.find(mesh);
+                            if (it != owner_index.end()) owners[it->second].objects.push_back(i);
+                            break;
+                        }
+                    return owners;
+                }
+
+                acul::shared_ptr<Block> find_meta_block(const Object &object, u32 signature)
+                {
+                    for (const auto &block : object.meta)
+                        if (block && block->signature() == signature) return block;
+                    return nullptr;
+                }
+
+                // Stores a block in every owner object, replacing a block with the same signature
+                void store_meta_block(Scene &scene, const MeshOwners &owners, const acul::shared_ptr<Block> &block)
+                {
+                    const u32 signature = block->signature();
+                    for (size_t i : owners.objects)
+                    {
+                        auto &meta = scene.objects[i].meta;
+                        auto it = std::find_if(meta.begin(), meta.end(), [signature](const acul::shared_ptr<Block> &b) {
+                            return b && b->signature() == signature;
+                        });
+                        if (it != meta.end())
+                            *it = block;
+                        else
+                            meta.push_back(block);
+                    }
+                }
+
+                // Removes blocks derived from the old mesh data from every owner object
+                void drop_meta_blocks(Scene &scene, const MeshOwners &owners, std::initializer_list<u32> signatures)
+                {
+                    for (size_t i : owners.objects)
+                    {
+                        auto &meta = scene.objects[i].meta;
+                        meta.erase(std::remove_if(meta.begin(), meta.end(),
+                                                  [&](const acul::shared_ptr<Block> &b) {
+                                                      return b && std::find(signatures.begin(), signatures.end(),
+                                                                            b->signature()) != signatures.end();
+                                                  }),
+                                   meta.end());
+                    }
+                }
+            } // namespace
+
+            u32 build_draw_ranges(Scene &scene, u64 default_id)
+            {
+                const auto owners = collect_mesh_owners(scene);
+                acul::vector<acul::shared_ptr<DrawRanges>> ranges(owners.size());
+                std::atomic<u32> failed{0};
+                oneapi::tbb::parallel_for(size_t(0), owners.size(), [&](size_t j) {
+                    acul::vector<acul::shared_ptr<MaterialRange>> materials;
+                    for (const auto &block : scene.objects[owners[j].objects.front()].meta)
+                        if (block && block->signature() == sign_block::material_range)
+                            materials.push_back(acul::static_pointer_cast<MaterialRange>(block));
+                    auto draw = acul::make_shared<DrawRanges>();
+                    if (build_draw_ranges(owners[j].mesh->model, materials, default_id, *draw))
+                    {
+                        owners[j].mesh->touch();
+                        ranges[j] = draw;
+                    }
+                    else
+                        failed.fetch_add(1, std::memory_order_relaxed);
+                });
+
+                for (size_t j = 0; j < owners.size(); ++j)
+                {
+                    if (!ranges[j]) continue;
+                    store_meta_block(scene, owners[j], ranges[j]);
+                    drop_meta_blocks(scene, owners[j], {sign_block::meshlets, sign_block::lod_chain, sign_block::bvh});
+                }
+                scene.invalidate_lookup();
+                return failed.load();
+            }
+
+            namespace
+            {
+                f32 corner_angle(const amal::vec3 &a, const amal::vec3 &b, const amal::vec3 &c)
+                {
+                    const amal::vec3 u = b - a, v = c - a;
+                    const f32 lengths = amal::sqrt(amal::dot(u, u) * amal::dot(v, v));
+                    if (lengths <= 0.0f) return 0.0f;
+                    return std::acos(std::clamp(amal::dot(u, v) / lengths, -1.0f, 1.0f));
+                }
+
+                // Unit projection of `t` onto the plane orthogonal to the normal `n`
+                amal::vec3 project_tangent(const amal::vec3 &t, const amal::vec3 &normal)
+                {
+                    const amal::vec3 n = safe_normalize(normal);
+                    return safe_normalize(t - n * amal::dot(n, t));
+                }
+
+                // Any unit vector perpendicular to `n`
+                amal::vec3 perpendicular(const amal::vec3 &n)
+                {
+                    const amal::vec3 axis = std::fabs(n.x) < 0.9f ? amal::vec3(1.0f, 0.0f, 0.0f)
+                                                                  : amal::vec3(0.0f, 1.0f, 0.0f);
+                    return safe_normalize(amal::cross(n, axis));
+                }
+            } // namespace
+
+            bool generate_tangents(Model &model, VertexAttributes &attributes, VertexFormat::enum_type format)
+            {
+                using range = oneapi::tbb::blocked_range<size_t>;
+                const size_t vertex_count = model.vertices.size();
+                const size_t face_count = model.faces.size();
+                const size_t index_count = model.indices.size();
+                if (!attributes.streams.empty() && attributes.vertex_count != vertex_count) return false;
+                if (vertex_format_components(format) < 4 || vertex_format_size(format) == 0) return false;
+                for (const auto &face : model.faces)
+                    if (face.first_vertex + static_cast<u64>(face.count) > index_count || face.count % 3 != 0)
+                        return false;
+
+                // Triangle tangents projected onto the tangent plane of the corner and weighted by its angle,
+                // one per index.
+                // The handedness of a face is the sign of its summed UV area.
+                acul::vector<amal::vec3> corners(index_count);
+                acul::vector<i8> face_signs(face_count);
+                acul::vector<std::atomic<u8>> vertex_signs(vertex_count);
+                for (auto &sign : vertex_signs) sign.store(0, std::memory_order_relaxed);
+                oneapi::tbb::parallel_for(range(0, face_count), [&](const range &r) {
+                    for (size_t f = r.begin(); f < r.end(); ++f)
+                    {
+                        const Face &face = model.faces[f];
+                        f32 uv_area = 0.0f;
+                        for (u32 i = face.first_vertex; i < face.first_vertex + face.count; i += 3)
+                        {
+                            const Vertex &v0 = model.vertices[model.indices[i]];
+                            const Vertex &v1 = model.vertices[model.indices[i + 1]];
+                            const Vertex &v2 = model.vertices[model.indices[i + 2]];
+                            const amal::vec3 e1 = v1.pos - v0.pos, e2 = v2.pos - v0.pos;
+                            const amal::vec2 d1 = v1.uv - v0.uv, d2 = v2.uv - v0.uv;
+                            const f32 det = d1.x * d2.y - d2.x * d1.y;
+                            uv_area += det;
+                            const amal::vec3 tangent =
+                                det != 0.0f ? safe_normalize((e1 * d2.y - e2 * d1.y) * (1.0f / det)) : amal::vec3(0.0f);
+                            corners[i] = project_tangent(tangent, v0.normal) * corner_angle(v0.pos, v1.pos, v2.pos);
+                            corners[i + 1] = project_tangent(tangent, v1.normal) * corner_angle(v1.pos, v2.pos, v0.pos);
+                            corners[i + 2] = project_tangent(tangent, v2.normal) * corner_angle(v2.pos, v0.pos, v1.pos);
+                        }
+                        face_signs[f] = uv_area < 0.0f ? -1 : 1;
+                        const u8 bit = face_signs[f] > 0 ? 1 : 2;
+                        for (u32 i = face.first_vertex; i < face.first_vertex + face.count; ++i)
+                            vertex_signs[model.indices[i]].fetch_or(bit, std::memory_order_relaxed);
+                    }
+                });
+
+                // Vertices shared by faces of both handedness get a copy for the mirrored faces
+                acul::vector<u32> split_ids(vertex_count, UINT32_MAX);
+                acul::vector<u32> split_sources;
+                for (size_t v = 0; v < vertex_count; ++v)
+                    if (vertex_signs[v].load(std::memory_order_relaxed) == 3)
+                    {
+                        split_ids[v] = static_cast<u32>(vertex_count + split_sources.size());
+                        split_sources.push_back(static_cast<u32>(v));
+                    }
+                const size_t split_count = split_sources.size();
+                const size_t new_vertex_count = vertex_count + split_count;
+                if (split_count > 0)
+                {
+                    model.vertices.resize(new_vertex_count);
+                    oneapi::tbb::parallel_for(range(0, split_count), [&](const range &r) {
+                        for (size_t s = r.begin(); s < r.end(); ++s)
+                            model.vertices[vertex_count + s] = model.vertices[split_sources[s]];
+                    });
+                    oneapi::tbb::parallel_for(range(0, face_count), [&](const range &r) {
+                        for (size_t f = r.begin(); f < r.end(); ++f)
+                        {
+                            if (face_signs[f] > 0) continue;
+                            Face &face = model.faces[f];
+                            for (u32 i = face.first_vertex; i < face.first_vertex + face.count; ++i)
+                                if (split_ids[model.indices[i]] != UINT32_MAX)
+                                    model.indices[i] = split_ids[model.indices[i]];
+                            for (auto &ref : face.vertices)
+                                if (ref.vertex < vertex_count && split_ids[ref.vertex] != UINT32_MAX)
+                                    ref.vertex = split_ids[ref.vertex];
+                        }
+                    });
+                    for (auto &stream : attributes.streams)
+                    {
+                        stream.data.resize(new_vertex_count * stream.stride);
+                        oneapi::tbb::parallel_for(range(0, split_count), [&](const range &r) {
+                            for (size_t s = r.begin(); s < r.end(); ++s)
+                                memcpy(stream.data.data() + (vertex_count + s) * stream.stride,
+                                       stream.data.data() + static_cast<size_t>(split_sources[s]) * stream.stride,
+                                       stream.stride);
+                        });
+                    }
+                }
+
+                // Corners grouped by vertex. Slots are sorted so that sums do not depend on scheduling.
+                acul::vector<std::atomic<u32>> cursors(new_vertex_count);
+                for (auto &cursor : cursors) cursor.store(0, std::memory_order_relaxed);
+                oneapi::tbb::parallel_for(range(0, index_count), [&](const range &r) {
+                    for (size_t i = r.begin(); i < r.end(); ++i)
+                        cursors[model.indices[i]].fetch_add(1, std::memory_order_relaxed);
+                });
+                acul::vector<u32> offsets(new_vertex_count + 1);
+                offsets[0] = 0;
+                for (size_t v = 0; v < new_vertex_count; ++v)
+                {
+                    offsets[v + 1] = offsets[v] + cursors[v].load(std::memory_order_relaxed);
+                    cursors[v].store(offsets[v], std::memory_order_relaxed);
+                }
+                acul::vector<u32> vertex_corners(index_count);
+                oneapi::tbb::parallel_for(range(0, index_count), [&](const range &r) {
+                    for (size_t i = r.begin(); i < r.end(); ++i)
+                        vertex_corners[cursors[model.indices[i]].fetch_add(1, std::memory_order_relaxed)] =
+                            static_cast<u32>(i);
+                });
+
+                acul::vector<amal::vec4> tangents(new_vertex_count);
+                oneapi::tbb::parallel_for(range(0, new_vertex_count), [&](const range &r) {
+                    for (size_t v = r.begin(); v < r.end(); ++v)
+                    {
+                        std::sort(vertex_corners.begin() + offsets[v], vertex_corners.begin() + offsets[v + 1]);
+                        amal::vec3 sum(0.0f);
+                        for (u32 c = offsets[v]; c < offsets[v + 1]; ++c) sum += corners[vertex_corners[c]];
+
+                        // Gram-Schmidt against the vertex normal
+                        const amal::vec3 n = safe_normalize(model.vertices[v].normal);
+                        amal::vec3 t = safe_normalize(sum - n * amal::dot(n, sum));
+                        if (amal::dot(t, t) == 0.0f)
+                            t = amal::dot(n, n) > 0.0f ? perpendicular(n) : amal::vec3(1.0f, 0.0f, 0.0f);
+                        const bool mirrored =
+                            v >= vertex_count || vertex_signs[v].load(std::memory_order_relaxed) == 2;
+                        tangents[v] = amal::vec4(t, mirrored ? -1.0f : 1.0f);
+                    }
+                });
+
+                attributes.vertex_count = static_cast<u32>(new_vertex_count);
+                const VertexElement *element = nullptr;
+                VertexStream *stream = const_cast<VertexStream *>(attributes.find(VertexAttribute::tangent, &element));
+                if (!stream) return add_vertex_stream(attributes, VertexAttribute::tangent, format, tangents);
+                oneapi::tbb::parallel_for(range(0, new_vertex_count), [&](const range &r) {
+                    for (size_t v = r.begin(); v < r.end(); ++v)
+                        encode_vertex_element(element->format, tangents[v],
+                                              stream->data.data() + v * stream->stride + element->offset);
+                });
+                return true;
+            }
+
+            u32 generate_tangents(Scene &scene, VertexFormat::enum_type format)
+            {
+                const auto owners = collect_mesh_owners(scene);
+                acul::vector<acul::shared_ptr<VertexAttributes>> attributes(owners.size());
+                acul::vector<u8> split(owners.size(), 0);
+                std::atomic<u32> failed{0};
+                oneapi::tbb::parallel_for(size_t(0), owners.size(), [&](size_t j) {
+                    auto existing = find_meta_block(scene.objects[owners[j].objects.front()],
+                                                    sign_block::vertex_attributes);
+                    auto block = existing ? acul::static_pointer_cast<VertexAttributes>(existing)
+                                          : acul::make_shared<VertexAttributes>();
+                    const size_t vertex_count = owners[j].mesh->model.vertices.size();
+                    if (generate_tangents(owners[j].mesh->model, *block, format))
+                    {
+                        split[j] = owners[j].mesh->model.vertices.size() != vertex_count;
+                        owners[j].mesh->touch();
+                        block->touch();
+                        attributes[j] = block;
+                    }
+                    else
+                        failed.fetch_add(1, std::memory_order_relaxed);
+                });
+
+                for (size_t j = 0; j < owners.size(); ++j)
+                {
+                    if (!attributes[j]) continue;
+                    store_meta_block(scene, owners[j], attributes[j]);
+                    if (split[j]) drop_meta_blocks(scene, owners[j], {sign_block::meshlets, sign_block::lod_chain});
+                }
+                scene.invalidate_lookup();
+                return failed.load();
+            }
+        } // namespace mesh
+    } // namespace utils
+} // namespace umbf
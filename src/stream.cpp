@@ -1,4 +1,8 @@
 #include <acul/log.hpp>
+#include <amal/half.hpp>
+#include <bit>
+#include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/parallel_reduce.h>
 #include <umbf/umbf.hpp>
 #include <umbf/utils.hpp>
 #include <umbf/version.h>
@@ -81,9 +85,30 @@ namespace umbf
             return material;
         }
 
-        void write_scene(acul::bin_stream &stream, Block *block)
+        // Points instance blocks to the `Mesh` blocks of their source objects
+        static void resolve_instances(Scene &scene)
+        {
+            for (u32 index : scene.objects_with(sign_block::mesh_instance))
+                for (auto &block : scene.objects[index].meta)
+                {
+                    if (!block || block->signature() != sign_block::mesh_instance) continue;
+                    auto *instance = static_cast<mesh::Instance *>(block.get());
+                    const Object *source = scene.find_object(instance->source);
+                    if (!source) continue;
+                    for (const auto &source_block : source->meta)
+                        if (source_block && source_block->signature() == sign_block::mesh)
+                        {
+                            instance->mesh = acul::static_pointer_cast<mesh::Mesh>(source_block);
+                            break;
+                        }
+                }
+        }
+
+        void write_scene_v1(acul::bin_stream &stream, Block *block)
         {
             auto scene = static_cast<Scene *>(block);
+            if (scene->objects.size() > UINT16_MAX)
+                throw acul::runtime_error(acul::format("Too many scene objects: %zu", scene->objects.size()));
             // Objects
             stream.write(static_cast<u16>(scene->objects.size()));
             for (const auto &object : scene->objects) stream.write(object.id).write(object.name).write(object.meta);
@@ -92,7 +117,7 @@ namespace umbf
             stream.write(scene->textures).write(scene->materials);
         }
 
-        Block *read_scene(acul::bin_stream &stream)
+        Block *read_scene_v1(acul::bin_stream &stream)
         {
             Scene *scene = acul::alloc<Scene>();
             u16 object_count;
@@ -100,10 +125,637 @@ namespace umbf
             scene->objects.resize(object_count);
             for (auto &object : scene->objects) stream.read(object.id).read(object.name).read(object.meta);
             stream.read(scene->textures).read(scene->materials);
+            resolve_instances(*scene);
             return scene;
         }
 
+        static_assert(std::is_trivially_copyable_v<mesh::Vertex> &&
+                          sizeof(mesh::Vertex) == sizeof(amal::vec3) * 2 + sizeof(amal::vec2),
+                      "Mesh vertices are serialized as raw arrays and must not contain padding");
+
+        // Arrays of the mesh block are aligned relative to the start of the block payload
+        static constexpr size_t g_mesh_array_alignment = 16;
+
+        static size_t mesh_padding(size_t offset)
+        {
+            return (g_mesh_array_alignment - offset % g_mesh_array_alignment) % g_mesh_array_alignment;
+        }
+
+        static void write_mesh_padding(acul::bin_stream &stream, size_t base)
+        {
+            static const char zeros[g_mesh_array_alignment]{};
+            stream.write(zeros, mesh_padding(stream.size() - base));
+        }
+
+        template <typename T>
+        static void write_mesh_array(acul::bin_stream &stream, size_t base, const T *data, size_t count)
+        {
+            write_mesh_padding(stream, base);
+            stream.write(data, count);
+        }
+
+        template <typename T>
+        static void read_mesh_array(acul::bin_stream &stream, size_t base, acul::vector<T> &dst, size_t count)
+        {
+            stream.shift(mesh_padding(stream.pos() - base));
+            if (stream.pos() > stream.size() || count * sizeof(T) > stream.size() - stream.pos())
+                throw acul::runtime_error("Mesh block is truncated");
+            dst.resize(count);
+            stream.read(dst.data(), count);
+        }
+
+        /**
+         * Mesh block layout:
+         *   u32 vertex_count, group_count, face_count, index_count, ref_count, flags
+         *   Vertex    vertices[vertex_count]
+         *   u32       indices[index_count]          - u16 with the 16-bit index flag
+         *   VertexRef refs[ref_count]               - vertex references of all faces
+         *   u32       face_offsets[face_count + 1]  - face ranges in refs
+         *   u32       face_first_index[face_count]
+         *   u32       face_index_count[face_count]
+         *   vec3      face_normals[face_count]
+         *   AABB, Transform
+         * Every array starts at a 16-byte boundary from the beginning of the block.
+         *
+         * With the quantized encoding flag the arrays are replaced by the quantization box followed by
+         * `codec::stream_count` group varint streams, each prefixed with its u64 byte size.
+         * Otherwise indices are stored as 16-bit values when the vertex count allows it.
+         */
+        namespace codec
+        {
+            static_assert(sizeof(f16) == sizeof(u16), "Half floats are stored as 16-bit values");
+
+            // Streams of the quantized mesh encoding in the order they are stored
+            enum : u32
+            {
+                pos_x,
+                pos_y,
+                pos_z,
+                uv_x,
+                uv_y,
+                normal_x,
+                normal_y,
+                index_buffer,
+                ref_groups,
+                ref_vertices,
+                face_ref_counts,
+                face_first_index,
+                face_index_count,
+                face_normal_x,
+                face_normal_y,
+                stream_count
+            };
+
+            // Bytes read past the last value by the decoder so that every value is loaded with one 32-bit read
+            static constexpr size_t g_varint_tail = 3;
+
+            static inline u32 zigzag(i32 v) { return (static_cast<u32>(v) << 1) ^ static_cast<u32>(v >> 31); }
+
+            static inline i32 unzigzag(u32 v) { return static_cast<i32>(v >> 1) ^ -static_cast<i32>(v & 1); }
+
+            // S is the signed type the difference between neighbours wraps to
+            template <typename S>
+            static void delta_encode(acul::vector<u32> &values)
+            {
+                u32 prev = 0;
+                for (auto &value : values)
+                {
+                    const S delta = static_cast<S>(value - prev);
+                    prev = value;
+                    value = zigzag(delta);
+                }
+            }
+
+            template <typename S>
+            static void delta_decode(acul::vector<u32> &values)
+            {
+                using U = std::make_unsigned_t<S>;
+                u32 prev = 0;
+                for (auto &value : values)
+                {
+                    prev = static_cast<U>(prev + static_cast<u32>(unzigzag(value)));
+                    value = prev;
+                }
+            }
+
+            /**
+             * Group varint: every control byte holds 2-bit byte lengths of the next four values, control bytes
+             * are followed by the value bytes. Decoding has no data dependent branches and maps to byte
+             * shuffles of SIMD decoders.
+             */
+            static void encode_varint_stream(const acul::vector<u32> &values, acul::vector<u8> &dst)
+            {
+                const size_t control_size = (values.size() + 3) / 4;
+                dst.resize(control_size);
+                dst.reserve(control_size + values.size() * sizeof(u32) + g_varint_tail);
+                std::fill(dst.begin(), dst.end(), 0);
+                for (size_t i = 0; i < values.size(); ++i)
+                {
+                    const u32 value = values[i];
+                    const u32 length = value < 0x100 ? 1 : (value < 0x10000 ? 2 : (value < 0x1000000 ? 3 : 4));
+                    dst[i / 4] |= static_cast<u8>((length - 1) << ((i % 4) * 2));
+                    for (u32 b = 0; b < length; ++b) dst.push_back(static_cast<u8>(value >> (b * 8)));
+                }
+                for (size_t i = 0; i < g_varint_tail; ++i) dst.push_back(0);
+            }
+
+            static void decode_varint_stream(const u8 *src, size_t size, size_t count, acul::vector<u32> &values)
+            {
+                static constexpr u32 masks[4] = {0xFF, 0xFFFF, 0xFFFFFF, 0xFFFFFFFF};
+                const size_t control_size = (count + 3) / 4;
+                if (size < control_size + g_varint_tail) throw acul::runtime_error("Mesh stream is truncated");
+                const u8 *control = src;
+                const u8 *data = src + control_size;
+                const u8 *data_end = src + size - g_varint_tail;
+                values.resize(count);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (data >= data_end) throw acul::runtime_error("Mesh stream is truncated");
+                    const u32 code = (control[i / 4] >> ((i % 4) * 2)) & 0x3;
+                    u32 value;
+                    memcpy(&value, data, sizeof(u32));
+                    values[i] = value & masks[code];
+                    data += code + 1;
+                }
+                if (data != data_end) throw acul::runtime_error("Mesh stream is corrupted");
+            }
+
+            static u16 quantize_unorm16(f32 value, f32 min, f32 scale)
+            {
+                const f32 q = (value - min) * scale;
+                return static_cast<u16>(q <= 0.0f ? 0.0f : (q >= 65535.0f ? 65535.0f : q + 0.5f));
+            }
+
+            static u16 quantize_snorm16(f32 value)
+            {
+                const f32 v = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+                return static_cast<u16>(static_cast<i16>(v * 32767.0f + (v >= 0.0f ? 0.5f : -0.5f)));
+            }
+
+            static f32 dequantize_snorm16(u32 value)
+            {
+                const f32 v = static_cast<i16>(static_cast<u16>(value)) / 32767.0f;
+                return v < -1.0f ? -1.0f : v;
+            }
+
+            static inline f32 sign_not_zero(f32 v) { return v >= 0.0f ? 1.0f : -1.0f; }
+
+            static void encode_octahedral(const amal::vec3 &n, u32 &x, u32 &y)
+            {
+                const f32 length = amal::abs(n.x) + amal::abs(n.y) + amal::abs(n.z);
+                if (length == 0.0f)
+                {
+                    x = y = 0;
+                    return;
+                }
+                f32 u = n.x / length, v = n.y / length;
+                if (n.z < 0.0f)
+                {
+                    const f32 pu = u;
+                    u = (1.0f - amal::abs(v)) * sign_not_zero(pu);
+                    v = (1.0f - amal::abs(pu)) * sign_not_zero(v);
+                }
+                x = quantize_snorm16(u);
+                y = quantize_snorm16(v);
+            }
+
+            static amal::vec3 decode_octahedral(u32 x, u32 y)
+            {
+                amal::vec3 n{dequantize_snorm16(x), dequantize_snorm16(y), 0.0f};
+                n.z = 1.0f - amal::abs(n.x) - amal::abs(n.y);
+                const f32 t = n.z < 0.0f ? -n.z : 0.0f;
+                n.x += n.x >= 0.0f ? -t : t;
+                n.y += n.y >= 0.0f ? -t : t;
+                return amal::normalize(n);
+            }
+
+            static u32 half_bits(f32 value)
+            {
+                return std::bit_cast<u16>(static_cast<f16>(value));
+            }
+
+            static f32 half_value(u32 bits)
+            {
+                return static_cast<f32>(std::bit_cast<f16>(static_cast<u16>(bits)));
+            }
+
+            static mesh::AABB quantization_box(const acul::vector<mesh::Vertex> &vertices, const mesh::AABB &aabb)
+            {
+                mesh::AABB box = aabb;
+                for (const auto &vertex : vertices)
+                {
+                    box.min = amal::min(box.min, vertex.pos);
+                    box.max = amal::max(box.max, vertex.pos);
+                }
+                return box;
+            }
+
+            static f32 quantization_scale(f32 extent) { return extent > 0.0f ? 65535.0f / extent : 0.0f; }
+
+            static void fill_stream(u32 id, const acul::vector<mesh::Vertex> &vertices, const mesh::FaceTable &faces,
+                                    const acul::vector<u32> &indices, const mesh::AABB &box, acul::vector<u32> &dst)
+            {
+                const u32 component = id - pos_x;
+                switch (id)
+                {
+                    case pos_x:
+                    case pos_y:
+                    case pos_z:
+                    {
+                        const f32 min = box.min[component];
+                        const f32 scale = quantization_scale(box.max[component] - min);
+                        dst.resize(vertices.size());
+                        for (size_t i = 0; i < vertices.size(); ++i)
+                            dst[i] = quantize_unorm16(vertices[i].pos[component], min, scale);
+                        delta_encode<i16>(dst);
+                        break;
+                    }
+                    case uv_x:
+                    case uv_y:
+                        dst.resize(vertices.size());
+                        for (size_t i = 0; i < vertices.size(); ++i) dst[i] = half_bits(vertices[i].uv[id - uv_x]);
+                        delta_encode<i16>(dst);
+                        break;
+                    case normal_x:
+                    case normal_y:
+                    {
+                        dst.resize(vertices.size());
+                        u32 oct[2];
+                        for (size_t i = 0; i < vertices.size(); ++i)
+                        {
+                            encode_octahedral(vertices[i].normal, oct[0], oct[1]);
+                            dst[i] = oct[id - normal_x];
+                        }
+                        delta_encode<i16>(dst);
+                        break;
+                    }
+                    case ref_groups:
+                    case ref_vertices:
+                        dst.resize(faces.refs.size());
+                        for (size_t i = 0; i < faces.refs.size(); ++i)
+                            dst[i] = id == ref_groups ? faces.refs[i].group : faces.refs[i].vertex;
+                        delta_encode<i32>(dst);
+                        break;
+                    case index_buffer:
+                        dst = indices;
+                        delta_encode<i32>(dst);
+                        break;
+                    case face_ref_counts:
+                        dst.resize(faces.size());
+                        for (size_t f = 0; f < faces.size(); ++f) dst[f] = faces.ref_count(f);
+                        break;
+                    case face_first_index:
+                    {
+                        // Residual against the index range following the previous face
+                        dst.resize(faces.size());
+                        u32 expected = 0;
+                        for (size_t f = 0; f < faces.size(); ++f)
+                        {
+                            dst[f] = zigzag(static_cast<i32>(faces.first_index[f] - expected));
+                            expected = faces.first_index[f] + faces.index_count[f];
+                        }
+                        break;
+                    }
+                    case face_index_count:
+                        dst = faces.index_count;
+                        break;
+                    case face_normal_x:
+                    case face_normal_y:
+                    {
+                        dst.resize(faces.size());
+                        u32 oct[2];
+                        for (size_t f = 0; f < faces.size(); ++f)
+                        {
+                            encode_octahedral(faces.normals[f], oct[0], oct[1]);
+                            dst[f] = oct[id - face_normal_x];
+                        }
+                        delta_encode<i16>(dst);
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+
+            static void write_quantized_arrays(acul::bin_stream &stream, const acul::vector<mesh::Vertex> &vertices,
+                                               const mesh::FaceTable &faces, const acul::vector<u32> &indices,
+                                               const mesh::AABB &aabb)
+            {
+                const mesh::AABB box = quantization_box(vertices, aabb);
+                acul::vector<acul::vector<u8>> encoded(stream_count);
+                oneapi::tbb::parallel_for(u32(0), u32(stream_count), [&](u32 id) {
+                    acul::vector<u32> values;
+                    fill_stream(id, vertices, faces, indices, box, values);
+                    encode_varint_stream(values, encoded[id]);
+                });
+
+                stream.write(box.min).write(box.max);
+                for (const auto &data : encoded)
+                    stream.write(static_cast<u64>(data.size())).write(data.data(), data.size());
+            }
+
+            static void read_quantized_arrays(acul::bin_stream &stream, u32 vertex_count, u32 face_count,
+                                              u32 index_count, u32 ref_count, mesh::CompactModel &model)
+            {
+                mesh::AABB box;
+                stream.read(box.min).read(box.max);
+
+                const u8 *sources[stream_count];
+                u64 sizes[stream_count];
+                for (u32 id = 0; id < stream_count; ++id)
+                {
+                    stream.read(sizes[id]);
+                    if (stream.pos() > stream.size() || sizes[id] > stream.size() - stream.pos())
+                        throw acul::runtime_error("Mesh block is truncated");
+                    sources[id] = reinterpret_cast<const u8 *>(stream.data() + stream.pos());
+                    stream.shift(sizes[id]);
+                }
+
+                auto value_count = [&](u32 id) -> size_t {
+                    if (id <= normal_y) return vertex_count;
+                    if (id == index_buffer) return index_count;
+                    if (id <= ref_vertices) return ref_count;
+                    return face_count;
+                };
+
+                acul::vector<acul::vector<u32>> values(stream_count);
+                oneapi::tbb::parallel_for(u32(0), u32(stream_count), [&](u32 id) {
+                    decode_varint_stream(sources[id], sizes[id], value_count(id), values[id]);
+                    switch (id)
+                    {
+                        case index_buffer:
+                        case ref_groups:
+                        case ref_vertices:
+                            delta_decode<i32>(values[id]);
+                            break;
+                        case face_ref_counts:
+                        case face_first_index:
+                        case face_index_count:
+                            break;
+                        default:
+                            delta_decode<i16>(values[id]);
+                            break;
+                    }
+                });
+
+                auto &faces = model.faces;
+                model.vertices.resize(vertex_count);
+                model.indices = std::move(values[index_buffer]);
+                faces.refs.resize(ref_count);
+                faces.offsets.resize(face_count + 1ULL);
+                faces.first_index.resize(face_count);
+                faces.index_count = std::move(values[face_index_count]);
+                faces.normals.resize(face_count);
+
+                u64 offset = 0;
+                u32 expected = 0;
+                faces.offsets[0] = 0;
+                for (u32 f = 0; f < face_count; ++f)
+                {
+                    offset += values[face_ref_counts][f];
+                    if (offset > ref_count) throw acul::runtime_error("Mesh face table is corrupted");
+                    faces.offsets[f + 1] = static_cast<u32>(offset);
+                    faces.first_index[f] = expected + static_cast<u32>(unzigzag(values[face_first_index][f]));
+                    expected = faces.first_index[f] + faces.index_count[f];
+                }
+                if (offset != ref_count) throw acul::runtime_error("Mesh face table is corrupted");
+
+                amal::vec3 step;
+                for (int c = 0; c < 3; ++c) step[c] = (box.max[c] - box.min[c]) / 65535.0f;
+
+                using range = oneapi::tbb::blocked_range<size_t>;
+                oneapi::tbb::parallel_for(range(0, vertex_count), [&](const range &r) {
+                    for (size_t i = r.begin(); i < r.end(); ++i)
+                    {
+                        auto &vertex = model.vertices[i];
+                        for (int c = 0; c < 3; ++c) vertex.pos[c] = box.min[c] + values[pos_x + c][i] * step[c];
+                        vertex.uv = {half_value(values[uv_x][i]), half_value(values[uv_y][i])};
+                        vertex.normal = decode_octahedral(values[normal_x][i], values[normal_y][i]);
+                    }
+                });
+                oneapi::tbb::parallel_for(range(0, ref_count), [&](const range &r) {
+                    for (size_t i = r.begin(); i < r.end(); ++i)
+                        faces.refs[i] = {values[ref_groups][i], values[ref_vertices][i]};
+                });
+                oneapi::tbb::parallel_for(range(0, face_count), [&](const range &r) {
+                    for (size_t f = r.begin(); f < r.end(); ++f)
+                        faces.normals[f] = decode_octahedral(values[face_normal_x][f], values[face_normal_y][f]);
+                });
+            }
+        } // namespace codec
+
+        // Set in the flags of mesh blocks that store 16-bit indices, never part of `mesh::Encoding`
+        static constexpr u32 g_mesh_index16_flag = 0x80000000;
+
+        // Rejects indices past the vertex array before they are written, whatever the index width or encoding
+        static void check_mesh_indices(const acul::vector<u32> &indices, size_t vertex_count)
+        {
+            using range = oneapi::tbb::blocked_range<size_t>;
+            const u32 max_index = oneapi::tbb::parallel_reduce(
+                range(0, indices.size(), 4096), 0u,
+                [&](const range &r, u32 value) {
+                    for (size_t i = r.begin(); i < r.end(); ++i) value = std::max(value, indices[i]);
+                    return value;
+                },
+                [](u32 a, u32 b) { return std::max(a, b); });
+            if (!indices.empty() && max_index >= vertex_count)
+                throw acul::runtime_error(
+                    acul::format("Index %u is out of range of %zu vertices", max_index, vertex_count));
+        }
+
+        static void write_mesh_data(acul::bin_stream &stream, const acul::vector<mesh::Vertex> &vertices,
+                                    u32 group_count, const mesh::FaceTable &faces, const acul::vector<u32> &indices,
+                                    const mesh::AABB &aabb, const mesh::Transform &transform,
+                                    mesh::Encoding encoding)
+        {
+            const size_t base = stream.size();
+            const bool quantized = encoding & mesh::EncodingBits::quantized;
+            const bool index16 = !quantized && vertices.size() <= mesh::IndexBuffer::max_16bit_vertices;
+            check_mesh_indices(indices, vertices.size());
+
+            // Sizes
+            stream.write(static_cast<u32>(vertices.size()))
+                .write(group_count)
+                .write(static_cast<u32>(faces.size()))
+                .write(static_cast<u32>(indices.size()))
+                .write(static_cast<u32>(faces.refs.size()))
+                .write(static_cast<u32>(encoding) | (index16 ? g_mesh_index16_flag : 0u));
+
+            if (quantized)
+                codec::write_quantized_arrays(stream, vertices, faces, indices, aabb);
+            else
+            {
+                write_mesh_array(stream, base, vertices.data(), vertices.size());
+                if (index16)
+                {
+                    const mesh::IndexBuffer buffer(indices, vertices.size());
+                    write_mesh_array(stream, base, buffer.indices16().data(), buffer.size());
+                }
+                else
+                    write_mesh_array(stream, base, indices.data(), indices.size());
+                write_mesh_array(stream, base, faces.refs.data(), faces.refs.size());
+                write_mesh_array(stream, base, faces.offsets.data(), faces.offsets.size());
+                write_mesh_array(stream, base, faces.first_index.data(), faces.first_index.size());
+                write_mesh_array(stream, base, faces.index_count.data(), faces.index_count.size());
+                write_mesh_array(stream, base, faces.normals.data(), faces.normals.size());
+            }
+
+            // Other meta info
+            stream.write(aabb.min)
+                .write(aabb.max)
+                .write(transform.position)
+                .write(transform.rotation)
+                .write(transform.scale);
+        }
+
+        // Rejects indices and references that point outside the decoded arrays
+        static void validate_mesh_data(const mesh::CompactModel &model)
+        {
+            using range = oneapi::tbb::blocked_range<size_t>;
+            const auto &faces = model.faces;
+            const size_t vertex_count = model.vertices.size();
+            const size_t index_count = model.indices.size();
+            oneapi::tbb::parallel_for(range(0, index_count), [&](const range &r) {
+                for (size_t i = r.begin(); i < r.end(); ++i)
+                    if (model.indices[i] >= vertex_count) throw acul::runtime_error("Mesh index is out of range");
+            });
+            oneapi::tbb::parallel_for(range(0, faces.refs.size()), [&](const range &r) {
+                for (size_t i = r.begin(); i < r.end(); ++i)
+                    if (faces.refs[i].vertex >= vertex_count || faces.refs[i].group >= model.group_count)
+                        throw acul::runtime_error("Mesh vertex reference is out of range");
+            });
+            oneapi::tbb::parallel_for(range(0, faces.size()), [&](const range &r) {
+                for (size_t f = r.begin(); f < r.end(); ++f)
+                    if (static_cast<u64>(faces.first_index[f]) + faces.index_count[f] > index_count)
+                        throw acul::runtime_error("Mesh face index range is out of range");
+            });
+        }
+
+        static void read_mesh_data(acul::bin_stream &stream, mesh::CompactModel &model, mesh::Transform &transform,
+                                   mesh::Encoding &encoding)
+        {
+            const size_t base = stream.pos();
+            u32 vertex_count, face_count, index_count, ref_count, flags;
+            stream.read(vertex_count)
+                .read(model.group_count)
+                .read(face_count)
+                .read(index_count)
+                .read(ref_count)
+                .read(flags);
+            if (flags & ~(static_cast<u32>(mesh::EncodingBits::quantized) | g_mesh_index16_flag))
+                throw acul::runtime_error(acul::format("Unsupported mesh block flags: 0x%08x", flags));
+            encoding = flags & mesh::EncodingBits::quantized ? mesh::EncodingBits::quantized : mesh::EncodingBits::none;
+            const bool index16 = flags & g_mesh_index16_flag;
+
+            auto &faces = model.faces;
+            if (encoding & mesh::EncodingBits::quantized)
+                codec::read_quantized_arrays(stream, vertex_count, face_count, index_count, ref_count, model);
+            else
+            {
+                read_mesh_array(stream, base, model.vertices, vertex_count);
+                if (index16)
+                {
+                    acul::vector<u16> indices;
+                    read_mesh_array(stream, base, indices, index_count);
+                    model.indices.resize(index_count);
+                    using range = oneapi::tbb::blocked_range<size_t>;
+                    oneapi::tbb::parallel_for(range(0, index_count), [&](const range &r) {
+                        for (size_t i = r.begin(); i < r.end(); ++i) model.indices[i] = indices[i];
+                    });
+                }
+                else
+                    read_mesh_array(stream, base, model.indices, index_count);
+                read_mesh_array(stream, base, faces.refs, ref_count);
+                read_mesh_array(stream, base, faces.offsets, face_count + 1ULL);
+                read_mesh_array(stream, base, faces.first_index, face_count);
+                read_mesh_array(stream, base, faces.index_count, face_count);
+                read_mesh_array(stream, base, faces.normals, face_count);
+                if (faces.offsets.back() != ref_count) throw acul::runtime_error("Mesh face table is corrupted");
+                for (u32 f = 0; f < face_count; ++f)
+                    if (faces.offsets[f] > faces.offsets[f + 1])
+                        throw acul::runtime_error("Mesh face table is corrupted");
+            }
+            validate_mesh_data(model);
+
+            // Other meta info
+            stream.read(model.aabb.min)
+                .read(model.aabb.max)
+                .read(transform.position)
+                .read(transform.rotation)
+                .read(transform.scale);
+        }
+
         void write_mesh(acul::bin_stream &stream, Block *block)
+        {
+            mesh::Mesh *mesh = static_cast<mesh::Mesh *>(block);
+            auto &model = mesh->model;
+            mesh::FaceTable faces;
+            utils::mesh::fill_face_table(model.faces, faces);
+            write_mesh_data(stream, model.vertices, model.group_count, faces, model.indices, model.aabb,
+                            mesh->transform, mesh->encoding);
+        }
+
+        Block *read_mesh(acul::bin_stream &stream)
+        {
+            mesh::CompactModel compact;
+            mesh::Transform transform;
+            mesh::Encoding encoding;
+            read_mesh_data(stream, compact, transform, encoding);
+
+            mesh::Mesh *mesh = acul::alloc<mesh::Mesh>();
+            auto &model = mesh->model;
+            model.vertices = std::move(compact.vertices);
+            model.group_count = compact.group_count;
+            utils::mesh::expand_face_table(compact.faces, model.faces);
+            model.indices = std::move(compact.indices);
+            model.aabb = compact.aabb;
+            mesh->transform = transform;
+            mesh->encoding = encoding;
+            return mesh;
+        }
+
+        void write_compact_mesh(acul::bin_stream &stream, Block *block)
+        {
+            auto *mesh = static_cast<mesh::CompactMesh *>(block);
+            auto &model = mesh->model;
+            write_mesh_data(stream, model.vertices, model.group_count, model.faces, model.indices, model.aabb,
+                            mesh->transform, mesh->encoding);
+        }
+
+        Block *read_compact_mesh(acul::bin_stream &stream)
+        {
+            mesh::CompactModel model;
+            mesh::Transform transform;
+            mesh::Encoding encoding;
+            read_mesh_data(stream, model, transform, encoding);
+
+            auto *mesh = acul::alloc<mesh::CompactMesh>();
+            mesh->model = std::move(model);
+            mesh->transform = transform;
+            mesh->encoding = encoding;
+            return mesh;
+        }
+
+        void write_mesh_instance(acul::bin_stream &stream, Block *block)
+        {
+            auto *instance = static_cast<mesh::Instance *>(block);
+            stream.write(instance->source)
+                .write(instance->transform.position)
+                .write(instance->transform.rotation)
+                .write(instance->transform.scale);
+        }
+
+        Block *read_mesh_instance(acul::bin_stream &stream)
+        {
+            auto *instance = acul::alloc<mesh::Instance>();
+            stream.read(instance->source)
+                .read(instance->transform.position)
+                .read(instance->transform.rotation)
+                .read(instance->transform.scale);
+            return instance;
+        }
+
+        void write_mesh_v1(acul::bin_stream &stream, Block *block)
         {
             mesh::Mesh *mesh = static_cast<mesh::Mesh *>(block);
             auto &model = mesh->model;
@@ -135,7 +787,7 @@ namespace umbf
                 .write(mesh->transform.scale);
         }
 
-        Block *read_mesh(acul::bin_stream &stream)
+        Block *read_mesh_v1(acul::bin_stream &stream)
         {
             mesh::Mesh *mesh = acul::alloc<mesh::Mesh>();
             auto &model = mesh->model;
@@ -172,6 +824,527 @@ namespace umbf
             return mesh;
         }
 
+        static_assert(std::is_trivially_copyable_v<mesh::Meshlet> && sizeof(mesh::Meshlet) == 48,
+                      "Meshlet descriptors are serialized as raw arrays and must not contain padding");
+
+        /**
+         * Meshlets block layout:
+         *   u32 meshlet_count, vertex_count, triangle_count
+         *   aligned arrays: meshlets, vertices, triangles (three bytes per triangle)
+         */
+        void write_meshlets(acul::bin_stream &stream, Block *block)
+        {
+            auto *meshlets = static_cast<mesh::Meshlets *>(block);
+            const size_t base = stream.size();
+            stream.write(static_cast<u32>(meshlets->meshlets.size()))
+                .write(static_cast<u32>(meshlets->vertices.size()))
+                .write(static_cast<u32>(meshlets->triangles.size() / 3));
+            write_mesh_array(stream, base, meshlets->meshlets.data(), meshlets->meshlets.size());
+            write_mesh_array(stream, base, meshlets->vertices.data(), meshlets->vertices.size());
+            write_mesh_array(stream, base, meshlets->triangles.data(), meshlets->triangles.size());
+        }
+
+        Block *read_meshlets(acul::bin_stream &stream)
+        {
+            const size_t base = stream.pos();
+            u32 meshlet_count, vertex_count, triangle_count;
+            stream.read(meshlet_count).read(vertex_count).read(triangle_count);
+
+            acul::vector<mesh::Meshlet> descriptors;
+            acul::vector<u32> vertices;
+            acul::vector<u8> triangles;
+            read_mesh_array(stream, base, descriptors, meshlet_count);
+            read_mesh_array(stream, base, vertices, vertex_count);
+            read_mesh_array(stream, base, triangles, triangle_count * 3ULL);
+            for (const auto &meshlet : descriptors)
+                if (meshlet.vertex_offset + static_cast<u64>(meshlet.vertex_count) > vertex_count ||
+                    meshlet.triangle_offset + meshlet.triangle_count * 3ULL > triangle_count * 3ULL)
+                    throw acul::runtime_error("Meshlets block is corrupted");
+
+            auto *block = acul::alloc<mesh::Meshlets>();
+            block->meshlets = std::move(descriptors);
+            block->vertices = std::move(vertices);
+            block->triangles = std::move(triangles);
+            return block;
+        }
+
+        static_assert(std::is_trivially_copyable_v<mesh::LodLevel> && sizeof(mesh::LodLevel) == 12,
+                      "LOD levels are serialized as raw arrays and must not contain padding");
+
+        /**
+         * LOD chain block layout:
+         *   u32 level_count, index_count
+         *   aligned arrays: levels, indices
+         */
+        void write_lod_chain(acul::bin_stream &stream, Block *block)
+        {
+            auto *chain = static_cast<mesh::LodChain *>(block);
+            const size_t base = stream.size();
+            stream.write(static_cast<u32>(chain->levels.size())).write(static_cast<u32>(chain->indices.size()));
+            write_mesh_array(stream, base, chain->levels.data(), chain->levels.size());
+            write_mesh_array(stream, base, chain->indices.data(), chain->indices.size());
+        }
+
+        Block *read_lod_chain(acul::bin_stream &stream)
+        {
+            const size_t base = stream.pos();
+            u32 level_count, index_count;
+            stream.read(level_count).read(index_count);
+
+            acul::vector<mesh::LodLevel> levels;
+            acul::vector<u32> indices;
+            read_mesh_array(stream, base, levels, level_count);
+            read_mesh_array(stream, base, indices, index_count);
+            for (const auto &level : levels)
+                if (level.first_index + static_cast<u64>(level.index_count) > index_count)
+                    throw acul::runtime_error("LOD chain block is corrupted");
+
+            auto *block = acul::alloc<mesh::LodChain>();
+            block->levels = std::move(levels);
+            block->indices = std::move(indices);
+            return block;
+        }
+
+        static_assert(std::is_trivially_copyable_v<mesh::DrawRange> && sizeof(mesh::DrawRange) == 16,
+                      "Draw ranges are serialized as raw arrays and must not contain padding");
+
+        /**
+         * Draw ranges block layout:
+         *   u32 range_count
+         *   aligned array: ranges
+         */
+        void write_draw_ranges(acul::bin_stream &stream, Block *block)
+        {
+            auto *draw = static_cast<mesh::DrawRanges *>(block);
+            const size_t base = stream.size();
+            stream.write(static_cast<u32>(draw->ranges.size()));
+            write_mesh_array(stream, base, draw->ranges.data(), draw->ranges.size());
+        }
+
+        Block *read_draw_ranges(acul::bin_stream &stream)
+        {
+            const size_t base = stream.pos();
+            u32 range_count;
+            stream.read(range_count);
+
+            acul::vector<mesh::DrawRange> ranges;
+            read_mesh_array(stream, base, ranges, range_count);
+            for (const auto &range : ranges)
+                if (range.first_index + static_cast<u64>(range.index_count) > UINT32_MAX)
+                    throw acul::runtime_error("Draw ranges block is corrupted");
+
+            auto *block = acul::alloc<mesh::DrawRanges>();
+            block->ranges = std::move(ranges);
+            return block;
+        }
+
+        static_assert(std::is_trivially_copyable_v<mesh::VertexElement> && sizeof(mesh::VertexElement) == 4,
+                      "Vertex elements are serialized as raw arrays and must not contain padding");
+
+        /**
+         * Vertex attributes block layout:
+         *   u32 vertex_count, stream_count
+         *   per stream: u32 stride, element_count
+         *               VertexElement elements[element_count]
+         *   aligned arrays: stream data, vertex_count * stride bytes each
+         */
+        void write_vertex_attributes(acul::bin_stream &stream, Block *block)
+        {
+            auto *attributes = static_cast<mesh::VertexAttributes *>(block);
+            const size_t base = stream.size();
+            stream.write(attributes->vertex_count).write(static_cast<u32>(attributes->streams.size()));
+            for (const auto &vertex_stream : attributes->streams)
+            {
+                if (vertex_stream.data.size() != static_cast<u64>(attributes->vertex_count) * vertex_stream.stride)
+                    throw acul::runtime_error("Vertex stream size does not match the vertex count");
+                stream.write(vertex_stream.stride)
+                    .write(static_cast<u32>(vertex_stream.elements.size()))
+                    .write(vertex_stream.elements.data(), vertex_stream.elements.size());
+            }
+            for (const auto &vertex_stream : attributes->streams)
+                write_mesh_array(stream, base, vertex_stream.data.data(), vertex_stream.data.size());
+        }
+
+        Block *read_vertex_attributes(acul::bin_stream &stream)
+        {
+            const size_t base = stream.pos();
+            u32 vertex_count, stream_count;
+            stream.read(vertex_count).read(stream_count);
+
+            acul::vector<mesh::VertexStream> streams;
+            for (u32 i = 0; i < stream_count; ++i)
+            {
+                auto &vertex_stream = streams.emplace_back();
+                u32 element_count;
+                stream.read(vertex_stream.stride).read(element_count);
+                read_mesh_array(stream, stream.pos(), vertex_stream.elements, element_count);
+                for (const auto &element : vertex_stream.elements)
+                {
+                    const u32 size = mesh::vertex_format_size(element.format);
+                    if (size == 0 || element.offset + size > vertex_stream.stride)
+                        throw acul::runtime_error("Vertex attributes block is corrupted");
+                }
+            }
+            for (auto &vertex_stream : streams)
+            {
+                const u64 size = static_cast<u64>(vertex_count) * vertex_stream.stride;
+                read_mesh_array(stream, base, vertex_stream.data, size);
+            }
+
+            auto *block = acul::alloc<mesh::VertexAttributes>();
+            block->vertex_count = vertex_count;
+            block->streams = std::move(streams);
+            return block;
+        }
+
+        static_assert(std::is_trivially_copyable_v<mesh::BvhNode> && sizeof(mesh::BvhNode) == 32,
+                      "BVH nodes are serialized as raw arrays and must not contain padding");
+
+        /**
+         * BVH block layout:
+         *   u32 node_count, primitive_count
+         *   aligned arrays: nodes, primitives
+         */
+        void write_bvh(acul::bin_stream &stream, Block *block)
+        {
+            auto *bvh = static_cast<mesh::Bvh *>(block);
+            const size_t base = stream.size();
+            stream.write(static_cast<u32>(bvh->nodes.size())).write(static_cast<u32>(bvh->primitives.size()));
+            write_mesh_array(stream, base, bvh->nodes.data(), bvh->nodes.size());
+            write_mesh_array(stream, base, bvh->primitives.data(), bvh->primitives.size());
+        }
+
+        Block *read_bvh(acul::bin_stream &stream)
+        {
+            const size_t base = stream.pos();
+            u32 node_count, primitive_count;
+            stream.read(node_count).read(primitive_count);
+
+            acul::vector<mesh::BvhNode> nodes;
+            acul::vector<u32> primitives;
+            read_mesh_array(stream, base, nodes, node_count);
+            read_mesh_array(stream, base, primitives, primitive_count);
+            // Children follow their parent in the depth-first layout, which also rules out cycles
+            for (u32 i = 0; i < node_count; ++i)
+            {
+                const auto &node = nodes[i];
+                const bool valid = node.is_leaf() ? node.first + static_cast<u64>(node.count) <= primitive_count
+                                                  : node.first > i && node.first + 1ULL < node_count;
+                if (!valid) throw acul::runtime_error("BVH block is corrupted");
+            }
+
+            auto *block = acul::alloc<mesh::Bvh>();
+            block->nodes = std::move(nodes);
+            block->primitives = std::move(primitives);
+            return block;
+        }
+
+        static_assert(std::is_trivially_copyable_v<mesh::AABB> && sizeof(mesh::AABB) == sizeof(amal::vec3) * 2,
+                      "Bounding boxes are serialized as raw arrays and must not contain padding");
+
+        /**
+         * Scene index block layout:
+         *   u32 node_count, primitive_count, object_count
+         *   f32 build_cost
+         *   aligned arrays: nodes, primitives, ids, bounds
+         */
+        void write_scene_index(acul::bin_stream &stream, Block *block)
+        {
+            auto *index = static_cast<SceneIndex *>(block);
+            const size_t base = stream.size();
+            stream.write(static_cast<u32>(index->nodes.size()))
+                .write(static_cast<u32>(index->primitives.size()))
+                .write(static_cast<u32>(index->ids.size()))
+                .write(index->build_cost);
+            write_mesh_array(stream, base, index->nodes.data(), index->nodes.size());
+            write_mesh_array(stream, base, index->primitives.data(), index->primitives.size());
+            write_mesh_array(stream, base, index->ids.data(), index->ids.size());
+            write_mesh_array(stream, base, index->bounds.data(), index->bounds.size());
+        }
+
+        Block *read_scene_index(acul::bin_stream &stream)
+        {
+            const size_t base = stream.pos();
+            u32 node_count, primitive_count, object_count;
+            f32 build_cost;
+            stream.read(node_count).read(primitive_count).read(object_count).read(build_cost);
+
+            acul::vector<mesh::BvhNode> nodes;
+            acul::vector<u32> primitives;
+            acul::vector<u64> ids;
+            acul::vector<mesh::AABB> bounds;
+            read_mesh_array(stream, base, nodes, node_count);
+            read_mesh_array(stream, base, primitives, primitive_count);
+            read_mesh_array(stream, base, ids, object_count);
+            read_mesh_array(stream, base, bounds, object_count);
+            for (u32 i = 0; i < node_count; ++i)
+            {
+                const auto &node = nodes[i];
+                const bool valid = node.is_leaf() ? node.first + static_cast<u64>(node.count) <= primitive_count
+                                                  : node.first > i && node.first + 1ULL < node_count;
+                if (!valid) throw acul::runtime_error("Scene index block is corrupted");
+            }
+            for (u32 primitive : primitives)
+                if (primitive >= object_count) throw acul::runtime_error("Scene index block is corrupted");
+
+            auto *block = acul::alloc<SceneIndex>();
+            block->nodes = std::move(nodes);
+            block->primitives = std::move(primitives);
+            block->ids = std::move(ids);
+            block->bounds = std::move(bounds);
+            block->build_cost = build_cost;
+            return block;
+        }
+
+        // Objects of a scene block are serialized and parsed in parallel in chunks of this size
+        static constexpr size_t g_scene_chunk_size = 1024;
+
+        static u32 checked_count(size_t count, const char *what)
+        {
+            if (count > UINT32_MAX) throw acul::runtime_error(acul::format("Too many %s: %zu", what, count));
+            return static_cast<u32>(count);
+        }
+
+        static bool cache_matches(const WriteCache &cache, const acul::vector<acul::shared_ptr<Block>> &blocks)
+        {
+            if (cache.generations.size() != blocks.size()) return false;
+            for (size_t i = 0; i < blocks.size(); ++i)
+                if (cache.generations[i] != blocks[i]->generation) return false;
+            return true;
+        }
+
+        static acul::shared_ptr<WriteCache> make_write_cache(const acul::bin_stream &stream, size_t begin,
+                                                             const acul::vector<acul::shared_ptr<Block>> &blocks)
+        {
+            auto cache = acul::make_shared<WriteCache>();
+            cache->bytes.resize(stream.size() - begin);
+            memcpy(cache->bytes.data(), stream.data() + begin, cache->bytes.size());
+            cache->generations.resize(blocks.size());
+            for (size_t i = 0; i < blocks.size(); ++i) cache->generations[i] = blocks[i]->generation;
+            return cache;
+        }
+
+        // Copies the cached bytes of an unchanged object, otherwise serializes the meta list and refreshes the cache
+        static void write_object_meta(acul::bin_stream &stream, Object &object, bool cache)
+        {
+            if (cache && !object.dirty && object.write_cache && cache_matches(*object.write_cache, object.meta))
+            {
+                stream.write(object.write_cache->bytes.data(), object.write_cache->bytes.size());
+                return;
+            }
+            const size_t begin = stream.size();
+            stream.write(object.meta);
+            if (!cache) return;
+            object.write_cache = make_write_cache(stream, begin, object.meta);
+            object.dirty = false;
+        }
+
+        static void write_scene_file(acul::bin_stream &stream, File &file, bool cache)
+        {
+            if (cache && !file.dirty && file.write_cache && cache_matches(*file.write_cache, file.blocks))
+            {
+                stream.write(file.write_cache->bytes.data(), file.write_cache->bytes.size());
+                return;
+            }
+            const size_t begin = stream.size();
+            stream.write(file);
+            if (!cache) return;
+            file.write_cache = make_write_cache(stream, begin, file.blocks);
+            file.dirty = false;
+        }
+
+        /**
+         * Scene block layout:
+         *   u32 object_count, texture_count, material_count
+         *   aligned arrays: ids (u64), name_offsets (u32, object_count + 1), names (chars),
+         *                   meta_offsets (u64, object_count + 1), meta (meta block lists)
+         *   texture files, material files
+         *
+         * Object `i` owns `[name_offsets[i], name_offsets[i + 1])` of the names and
+         * `[meta_offsets[i], meta_offsets[i + 1])` of the meta bytes. Every meta range is a zero-terminated
+         * block list, so ranges can be parsed independently.
+         */
+        void write_scene(acul::bin_stream &stream, Block *block)
+        {
+            using range = oneapi::tbb::blocked_range<size_t>;
+            auto *scene = static_cast<Scene *>(block);
+            auto &objects = scene->objects;
+            const size_t object_count = objects.size();
+            const size_t base = stream.size();
+            stream.write(checked_count(object_count, "scene objects"))
+                .write(checked_count(scene->textures.size(), "scene textures"))
+                .write(checked_count(scene->materials.size(), "scene materials"));
+
+            acul::vector<u64> ids(object_count);
+            acul::vector<u32> name_offsets(object_count + 1);
+            name_offsets[0] = 0;
+            for (size_t i = 0; i < object_count; ++i)
+            {
+                ids[i] = objects[i].id;
+                const u64 end = static_cast<u64>(name_offsets[i]) + objects[i].name.size();
+                if (end > UINT32_MAX) throw acul::runtime_error("Scene object names exceed 4 GiB");
+                name_offsets[i + 1] = static_cast<u32>(end);
+            }
+            acul::vector<char> names(name_offsets[object_count]);
+            oneapi::tbb::parallel_for(range(0, object_count), [&](const range &r) {
+                for (size_t i = r.begin(); i < r.end(); ++i)
+                    std::copy(objects[i].name.begin(), objects[i].name.end(), names.begin() + name_offsets[i]);
+            });
+
+            // Meta lists are serialized per chunk, offsets are made global afterwards
+            const size_t chunk_count = (object_count + g_scene_chunk_size - 1) / g_scene_chunk_size;
+            acul::vector<acul::bin_stream> chunks(chunk_count);
+            acul::vector<u64> meta_offsets(object_count + 1);
+            oneapi::tbb::parallel_for(size_t(0), chunk_count, [&](size_t c) {
+                const size_t last = amal::min(object_count, (c + 1) * g_scene_chunk_size);
+                for (size_t i = c * g_scene_chunk_size; i < last; ++i)
+                {
+                    meta_offsets[i] = chunks[c].size();
+                    write_object_meta(chunks[c], objects[i], scene->cache_writes);
+                }
+            });
+            u64 chunk_base = 0;
+            for (size_t c = 0; c < chunk_count; ++c)
+            {
+                const size_t last = amal::min(object_count, (c + 1) * g_scene_chunk_size);
+                for (size_t i = c * g_scene_chunk_size; i < last; ++i) meta_offsets[i] += chunk_base;
+                chunk_base += chunks[c].size();
+            }
+            meta_offsets[object_count] = chunk_base;
+
+            write_mesh_array(stream, base, ids.data(), ids.size());
+            write_mesh_array(stream, base, name_offsets.data(), name_offsets.size());
+            write_mesh_array(stream, base, names.data(), names.size());
+            write_mesh_array(stream, base, meta_offsets.data(), meta_offsets.size());
+            write_mesh_padding(stream, base);
+            for (const auto &chunk : chunks) stream.write(chunk.data(), chunk.size());
+
+            for (auto &file : scene->textures) write_scene_file(stream, file, scene->cache_writes);
+            for (auto &file : scene->materials) write_scene_file(stream, file, scene->cache_writes);
+        }
+
+        static void check_offsets(const acul::vector<u32> &offsets, const char *what)
+        {
+            if (offsets.front() != 0) throw acul::runtime_error(acul::format("Scene %s table is corrupted", what));
+            for (size_t i = 1; i < offsets.size(); ++i)
+                if (offsets[i] < offsets[i - 1])
+                    throw acul::runtime_error(acul::format("Scene %s table is corrupted", what));
+        }
+
+        Block *read_scene(acul::bin_stream &stream)
+        {
+            const size_t base = stream.pos();
+            u32 object_count, texture_count, material_count;
+            stream.read(object_count).read(texture_count).read(material_count);
+
+            acul::vector<u64> ids, meta_offsets;
+            acul::vector<u32> name_offsets;
+            acul::vector<char> names;
+            read_mesh_array(stream, base, ids, object_count);
+            read_mesh_array(stream, base, name_offsets, object_count + 1ULL);
+            check_offsets(name_offsets, "name");
+            read_mesh_array(stream, base, names, name_offsets.back());
+            read_mesh_array(stream, base, meta_offsets, object_count + 1ULL);
+            stream.shift(mesh_padding(stream.pos() - base));
+            if (meta_offsets.front() != 0 || stream.pos() > stream.size() ||
+                meta_offsets.back() > stream.size() - stream.pos())
+                throw acul::runtime_error("Scene meta table is corrupted");
+            for (size_t i = 0; i < object_count; ++i)
+                if (meta_offsets[i + 1] < meta_offsets[i]) throw acul::runtime_error("Scene meta table is corrupted");
+
+            // Names and meta lists are independent per object, chunks are parsed in parallel
+            acul::vector<Object> objects(object_count);
+            const char *meta = stream.data() + stream.pos();
+            const size_t chunk_count = (object_count + g_scene_chunk_size - 1) / g_scene_chunk_size;
+            oneapi::tbb::parallel_for(size_t(0), chunk_count, [&](size_t c) {
+                const size_t first = c * g_scene_chunk_size;
+                const size_t last = amal::min<size_t>(object_count, first + g_scene_chunk_size);
+                const u64 chunk_base = meta_offsets[first];
+                acul::bin_stream chunk(acul::vector<char>(meta + chunk_base, meta + meta_offsets[last]));
+                for (size_t i = first; i < last; ++i)
+                {
+                    auto &object = objects[i];
+                    object.id = ids[i];
+                    object.name = acul::string(names.data() + name_offsets[i], name_offsets[i + 1] - name_offsets[i]);
+                    chunk.pos(meta_offsets[i] - chunk_base);
+                    chunk.read(object.meta);
+                }
+            });
+            stream.shift(meta_offsets.back());
+
+            acul::vector<File> textures(texture_count), materials(material_count);
+            for (auto &file : textures) stream.read(file);
+            for (auto &file : materials) stream.read(file);
+
+            Scene *scene = acul::alloc<Scene>();
+            scene->objects = std::move(objects);
+            scene->textures = std::move(textures);
+            scene->materials = std::move(materials);
+            resolve_instances(*scene);
+            return scene;
+        }
+
+        static_assert(std::is_trivially_copyable_v<SceneCell> && sizeof(SceneCell) == 56,
+                      "Scene cells are serialized as raw arrays and must not contain padding");
+
+        /**
+         * Scene cells block layout:
+         *   f32 cell_size
+         *   u32 cell_count
+         *   aligned arrays: shared cell (1), cells
+         *   u32 dependency_count
+         *   aligned arrays: dependency_offsets (u32, cell_count + 1), dependencies (u32)
+         */
+        void write_scene_cells(acul::bin_stream &stream, Block *block)
+        {
+            auto *index = static_cast<SceneCells *>(block);
+            const size_t base = stream.size();
+            stream.write(index->cell_size).write(checked_count(index->cells.size(), "scene cells"));
+            write_mesh_array(stream, base, &index->shared, 1);
+            write_mesh_array(stream, base, index->cells.data(), index->cells.size());
+            stream.write(checked_count(index->dependencies.size(), "scene cell dependencies"));
+            write_mesh_array(stream, base, index->dependency_offsets.data(), index->dependency_offsets.size());
+            write_mesh_array(stream, base, index->dependencies.data(), index->dependencies.size());
+        }
+
+        Block *read_scene_cells(acul::bin_stream &stream)
+        {
+            const size_t base = stream.pos();
+            f32 cell_size;
+            u32 cell_count;
+            stream.read(cell_size).read(cell_count);
+
+            acul::vector<SceneCell> shared;
+            acul::vector<SceneCell> cells;
+            read_mesh_array(stream, base, shared, 1);
+            read_mesh_array(stream, base, cells, cell_count);
+            for (const auto &cell : cells)
+                if (cell.offset + cell.size < cell.offset)
+                    throw acul::runtime_error("Scene cells block is corrupted");
+
+            u32 dependency_count;
+            stream.read(dependency_count);
+            acul::vector<u32> dependency_offsets;
+            acul::vector<u32> dependencies;
+            read_mesh_array(stream, base, dependency_offsets, static_cast<size_t>(cell_count) + 1);
+            read_mesh_array(stream, base, dependencies, dependency_count);
+            if (dependency_offsets.front() != 0 || dependency_offsets.back() != dependency_count)
+                throw acul::runtime_error("Scene cells block is corrupted");
+            for (u32 c = 0; c < cell_count; ++c)
+                if (dependency_offsets[c] > dependency_offsets[c + 1])
+                    throw acul::runtime_error("Scene cells block is corrupted");
+            for (u32 cell : dependencies)
+                if (cell >= cell_count) throw acul::runtime_error("Scene cells block is corrupted");
+
+            auto *block = acul::alloc<SceneCells>();
+            block->cell_size = cell_size;
+            block->shared = shared.front();
+            block->cells = std::move(cells);
+            block->dependency_offsets = std::move(dependency_offsets);
+            block->dependencies = std::move(dependencies);
+            return block;
+        }
+
         Block *read_material_info(acul::bin_stream &stream)
         {
             MaterialInfo *block = acul::alloc<MaterialInfo>();
@@ -191,7 +1364,7 @@ namespace umbf
                 .write(material->assignments.data(), material->assignments.size());
         }
 
-        void write_material_range(acul::bin_stream &stream, Block *block)
+        void write_material_range_v1(acul::bin_stream &stream, Block *block)
         {
             MaterialRange *assignment = static_cast<MaterialRange *>(block);
             stream.write(assignment->mat_id)
@@ -199,7 +1372,7 @@ namespace umbf
                 .write(assignment->faces.data(), assignment->faces.size());
         }
 
-        Block *read_material_range(acul::bin_stream &stream)
+        Block *read_material_range_v1(acul::bin_stream &stream)
         {
             MaterialRange *block = acul::alloc<MaterialRange>();
             u32 face_size;
@@ -209,6 +1382,85 @@ namespace umbf
             return block;
         }
 
+        struct FaceEncoding
+        {
+            enum enum_type : u8
+            {
+                list, ///< Face indices as stored
+                runs  ///< Strictly ascending faces stored as `FaceSet::Run`s
+            };
+        };
+
+        static_assert(std::is_trivially_copyable_v<FaceSet::Run> && sizeof(FaceSet::Run) == 8,
+                      "Face runs are serialized as raw arrays and must not contain padding");
+
+        /**
+         * Material range block layout:
+         *   u64 mat_id
+         *   u8  encoding
+         *   u32 count
+         *   u32 faces[count] or FaceSet::Run runs[count]
+         *
+         * Runs are used when the faces are strictly ascending and take less space, so decoding is lossless.
+         */
+        void write_material_range(acul::bin_stream &stream, Block *block)
+        {
+            MaterialRange *assignment = static_cast<MaterialRange *>(block);
+            const auto &faces = assignment->faces;
+            acul::vector<FaceSet::Run> runs;
+            bool ascending = true;
+            for (size_t i = 0; i < faces.size() && ascending; ++i)
+            {
+                if (i > 0 && faces[i] <= faces[i - 1])
+                    ascending = false;
+                else if (!runs.empty() && faces[i] == faces[i - 1] + 1)
+                    ++runs.back().count;
+                else
+                    runs.push_back({faces[i], 1});
+            }
+            stream.write(assignment->mat_id);
+            if (ascending && runs.size() * 2 < faces.size())
+                stream.write(static_cast<u8>(FaceEncoding::runs))
+                    .write(static_cast<u32>(runs.size()))
+                    .write(runs.data(), runs.size());
+            else
+                stream.write(static_cast<u8>(FaceEncoding::list))
+                    .write(static_cast<u32>(faces.size()))
+                    .write(faces.data(), faces.size());
+        }
+
+        Block *read_material_range(acul::bin_stream &stream)
+        {
+            u64 mat_id;
+            u8 encoding;
+            u32 count;
+            stream.read(mat_id).read(encoding).read(count);
+            acul::vector<u32> faces;
+            if (encoding == FaceEncoding::list)
+                read_mesh_array(stream, stream.pos(), faces, count);
+            else if (encoding == FaceEncoding::runs)
+            {
+                FaceSet set;
+                read_mesh_array(stream, stream.pos(), set.runs, count);
+                u64 face_count = 0;
+                for (const auto &run : set.runs)
+                {
+                    face_count += run.count;
+                    if (static_cast<u64>(run.first) + run.count > static_cast<u64>(UINT32_MAX) + 1 ||
+                        face_count > UINT32_MAX)
+                        throw acul::runtime_error("Material range block is corrupted");
+                }
+                set.append_to(faces);
+            }
+            else
+                throw acul::runtime_error(acul::format("Unknown material range encoding: %u", encoding));
+
+            MaterialRange *block = acul::alloc<MaterialRange>();
+            block->mat_id = mat_id;
+            block->faces = std::move(faces);
+            return block;
+        }
+
         void write_target(acul::bin_stream &stream, Block *block)
         {
             auto target = static_cast<Target *>(block);
@@ -225,10 +1477,23 @@ namespace umbf
         void write_library(acul::bin_stream &stream, Block *block)
         {
             auto library = static_cast<Library *>(block);
-            stream.write(library->file_tree);
+            write_library_tree(stream, library->file_tree);
         }
 
         Block *read_library(acul::bin_stream &stream)
+        {
+            Library *library = acul::alloc<Library>();
+            read_library_tree(stream, library->file_tree);
+            return library;
+        }
+
+        void write_library_v1(acul::bin_stream &stream, Block *block)
+        {
+            auto library = static_cast<Library *>(block);
+            stream.write(library->file_tree);
+        }
+
+        Block *read_library_v1(acul::bin_stream &stream)
         {
             Library *library = acul::alloc<Library>();
             stream.read(library->file_tree);
@@ -263,17 +1528,49 @@ namespace umbf
             stream.write(mapping->offset).write(mapping->size);
         }
 
+        Block *read_inline_mapping_block(acul::bin_stream &stream)
+        {
+            u64 size = 0;
+            stream.read(size);
+            if (stream.pos() > stream.size() || size > stream.size() - stream.pos())
+                throw acul::runtime_error("Inline mapping block is truncated");
+            auto *block = acul::alloc<InlineMapping>();
+            block->data.resize(size);
+            stream.read(block->data.data(), size);
+            return block;
+        }
+
+        void write_inline_mapping_block(acul::bin_stream &stream, Block *content)
+        {
+            auto *mapping = static_cast<InlineMapping *>(content);
+            stream.write(static_cast<u64>(mapping->data.size())).write(mapping->data.data(), mapping->data.size());
+        }
+
         UMBF_EXPORT const Stream image{read_image, write_image};
         UMBF_EXPORT const Stream image_atlas{read_image_atlas, write_image_atlas};
         UMBF_EXPORT const Stream material{read_material, write_material};
         UMBF_EXPORT const Stream material_info{read_material_info, write_material_info};
         UMBF_EXPORT const Stream material_range{read_material_range, write_material_range};
+        UMBF_EXPORT const Stream material_range_v1{read_material_range_v1, write_material_range_v1};
         UMBF_EXPORT const Stream scene{read_scene, write_scene};
+        UMBF_EXPORT const Stream scene_v1{read_scene_v1, write_scene_v1};
         UMBF_EXPORT const Stream mesh{read_mesh, write_mesh};
+        UMBF_EXPORT const Stream mesh_v1{read_mesh_v1, write_mesh_v1};
+        UMBF_EXPORT const Stream compact_mesh{read_compact_mesh, write_compact_mesh};
+        UMBF_EXPORT const Stream mesh_instance{read_mesh_instance, write_mesh_instance};
+        UMBF_EXPORT const Stream meshlets{read_meshlets, write_meshlets};
+        UMBF_EXPORT const Stream lod_chain{read_lod_chain, write_lod_chain};
+        UMBF_EXPORT const Stream draw_ranges{read_draw_ranges, write_draw_ranges};
+        UMBF_EXPORT const Stream vertex_attributes{read_vertex_attributes, write_vertex_attributes};
+        UMBF_EXPORT const Stream bvh{read_bvh, write_bvh};
+        UMBF_EXPORT const Stream scene_index{read_scene_index, write_scene_index};
+        UMBF_EXPORT const Stream scene_cells{read_scene_cells, write_scene_cells};
         UMBF_EXPORT const Stream target{read_target, write_target};
         UMBF_EXPORT const Stream library{read_library, write_library};
+        UMBF_EXPORT const Stream library_v1{read_library_v1, write_library_v1};
         UMBF_EXPORT const Stream raw_block{read_raw_block, write_raw_block};
         UMBF_EXPORT const Stream mapping_block{read_mapping_block, write_mapping_block};
+        UMBF_EXPORT const Stream inline_mapping_block{read_inline_mapping_block, write_inline_mapping_block};
     } // namespace streams
 
     void insert_default_streams(streams::HashResolver &resolver)
@@ -281,13 +1578,27 @@ namespace umbf
         resolver.streams[sign_block::image] = &streams::image;
         resolver.streams[sign_block::image_atlas] = &streams::image_atlas;
         resolver.streams[sign_block::mesh] = &streams::mesh;
+        resolver.streams[sign_block::compact_mesh] = &streams::compact_mesh;
+        resolver.streams[sign_block::mesh_v1] = &streams::mesh_v1;
+        resolver.streams[sign_block::mesh_instance] = &streams::mesh_instance;
+        resolver.streams[sign_block::meshlets] = &streams::meshlets;
+        resolver.streams[sign_block::lod_chain] = &streams::lod_chain;
+        resolver.streams[sign_block::draw_ranges] = &streams::draw_ranges;
+        resolver.streams[sign_block::vertex_attributes] = &streams::vertex_attributes;
+        resolver.streams[sign_block::bvh] = &streams::bvh;
+        resolver.streams[sign_block::scene_index] = &streams::scene_index;
+        resolver.streams[sign_block::scene_cells] = &streams::scene_cells;
         resolver.streams[sign_block::material_range] = &streams::material_range;
+        resolver.streams[sign_block::material_range_v1] = &streams::material_range_v1;
         resolver.streams[sign_block::material] = &streams::material;
         resolver.streams[sign_block::material_info] = &streams::material_info;
         resolver.streams[sign_block::scene] = &streams::scene;
+        resolver.streams[sign_block::scene_v1] = &streams::scene_v1;
         resolver.streams[sign_block::target] = &streams::target;
         resolver.streams[sign_block::library] = &streams::library;
+        resolver.streams[sign_block::library_v1] = &streams::library_v1;
         resolver.streams[sign_block::raw] = &streams::raw_block;
         resolver.streams[sign_block::mapping] = &streams::mapping_block;
+        resolver.streams[sign_block::inline_mapping] = &streams::inline_mapping_block;
     }
 } // namespace umbf
@@ -1,7 +1,13 @@
 #include <acul/io/fs/file.hpp>
 #include <acul/io/fs/path.hpp>
 #include <acul/log.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <inttypes.h>
+#include <numeric>
+#include <oneapi/tbb/parallel_for.h>
+#include <oneapi/tbb/parallel_sort.h>
 #include <umbf/umbf.hpp>
 #include <umbf/utils.hpp>
 
@@ -30,6 +36,12 @@ namespace umbf
         g_log.logger = logger;
     }
 
+    UMBF_EXPORT u64 next_block_generation()
+    {
+        static std::atomic<u64> generation{0};
+        return generation.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
     UMBF_EXPORT void pack_header(const File::Header &src, File::Header::Pack &dst)
     {
         dst.vendor_sign = src.vendor_sign & 0xFFFFFF;
@@ -189,133 +201,589 @@ namespace umbf
         return block_size;
     }
 
-    UMBF_EXPORT acul::op_result load_library_mapped(const acul::path &path, LibraryMapData &mapping)
+    // Mapped files hold an index block followed by a raw block with the payload addressed by the index
+    static acul::op_result open_mapped_file(const acul::path &path, u16 type_sign, u32 index_sign, FILE *&fd,
+                                            acul::shared_ptr<Block> &index, u64 &payload_offset,
+                                            u64 &payload_size, bool &compressed)
     {
+        auto fail = [&fd](acul::op_result result) {
+            if (fd) fclose(fd);
+            fd = nullptr;
+            return result;
+        };
+
         try
         {
-            close_library_map_fd(mapping);
-            mapping.path = path;
-            mapping.library.reset();
-            mapping.payload_offset = 0;
-            mapping.payload_size = 0;
-            mapping.compressed = false;
-            const size_t file_size = acul::fs::read_binary_fd(path, mapping.fd);
-            if (file_size == 0) return acul::make_op_error(ACUL_OP_READ_ERROR);
+            const size_t file_size = acul::fs::read_binary_fd(path, fd);
+            if (file_size == 0) return fail(acul::make_op_error(ACUL_OP_READ_ERROR));
             File::Header header;
             size_t header_section_size = sizeof(File::Header::Pack) + sizeof(u32);
             acul::vector<char> source_bytes(header_section_size);
-            if (fread(source_bytes.data(), 1, header_section_size, mapping.fd) != header_section_size)
-            {
-                close_library_map_fd(mapping);
-                return acul::make_op_error(ACUL_OP_READ_ERROR);
-            }
+            if (fread(source_bytes.data(), 1, header_section_size, fd) != header_section_size)
+                return fail(acul::make_op_error(ACUL_OP_READ_ERROR));
             acul::bin_stream source_stream(std::move(source_bytes));
-            if (!read_file_header(source_stream, header))
-            {
-                close_library_map_fd(mapping);
-                return acul::make_op_error(ACUL_OP_ERROR_GENERIC);
-            }
-            mapping.compressed = header.flags & UMBF_COMPRESSION_MAPPED_BIT;
-            if (header.vendor_sign != UMBF_VENDOR_ID || header.type_sign != sign_block::format::library)
+            if (!read_file_header(source_stream, header)) return fail(acul::make_op_error(ACUL_OP_ERROR_GENERIC));
+            compressed = header.flags & UMBF_COMPRESSION_MAPPED_BIT;
+            if (header.vendor_sign != UMBF_VENDOR_ID || header.type_sign != type_sign)
             {
                 UMBF_LOG_ERROR("Invalid asset type");
-                close_library_map_fd(mapping);
-                return acul::make_op_error(ACUL_OP_ERROR_GENERIC);
+                return fail(acul::make_op_error(ACUL_OP_ERROR_GENERIC));
             }
 
-            const i64 first_block_offset = acul::fs::ftell(mapping.fd);
-            if (first_block_offset < 0)
-            {
-                close_library_map_fd(mapping);
-                return acul::make_op_error(ACUL_OP_READ_ERROR);
-            }
+            const i64 first_block_offset = acul::fs::ftell(fd);
+            if (first_block_offset < 0) return fail(acul::make_op_error(ACUL_OP_READ_ERROR));
+
+            u64 index_block_size = 0;
+            if (fread(&index_block_size, sizeof(index_block_size), 1, fd) != 1 || index_block_size == 0)
+                return fail(acul::make_op_error(ACUL_OP_READ_ERROR));
+
+            if (acul::fs::fseek(fd, static_cast<u64>(first_block_offset), SEEK_SET) != 0)
+                return fail(acul::make_op_error(ACUL_OP_READ_ERROR));
 
-            u64 library_block_size = 0;
-            if (fread(&library_block_size, sizeof(library_block_size), 1, mapping.fd) != 1 || library_block_size == 0)
+            acul::vector<char> index_buffer(g_mapped_block_prefix_size + index_block_size);
+            if (fread(index_buffer.data(), 1, index_buffer.size(), fd) != index_buffer.size())
+                return fail(acul::make_op_error(ACUL_OP_READ_ERROR));
+
+            acul::bin_stream index_stream(std::move(index_buffer));
+            if (umbf::read_next_meta_block(index_stream, index) == 0ULL || !index ||
+                index->signature() != index_sign)
             {
-                close_library_map_fd(mapping);
-                return acul::make_op_error(ACUL_OP_READ_ERROR);
+                UMBF_LOG_ERROR("Unexpected first mapped block, expected 0x%08x", index_sign);
+                index.reset();
+                return fail(acul::make_op_error(ACUL_OP_ERROR_GENERIC));
             }
 
-            if (acul::fs::fseek(mapping.fd, static_cast<u64>(first_block_offset), SEEK_SET) != 0)
+            const i64 raw_block_offset = acul::fs::ftell(fd);
+            if (raw_block_offset < 0) return fail(acul::make_op_error(ACUL_OP_READ_ERROR));
+
+            u64 raw_block_size = 0;
+            if (fread(&raw_block_size, sizeof(raw_block_size), 1, fd) != 1 || raw_block_size < sizeof(u64))
+                return fail(acul::make_op_error(ACUL_OP_READ_ERROR));
+
+            payload_offset =
+                static_cast<u64>(raw_block_offset) + g_mapped_block_prefix_size + g_raw_block_data_size_field;
+            payload_size = raw_block_size - g_raw_block_data_size_field;
+        }
+        catch (std::exception &e)
+        {
+            UMBF_LOG_ERROR("%s", e.what());
+            return fail(acul::make_op_error(ACUL_OP_ERROR_GENERIC));
+        }
+        return acul::make_op_success();
+    }
+
+    // Reads a range of the mapped payload without decoding it
+    static acul::op_result read_mapped_range(FILE *fd, u64 payload_offset, u64 payload_size, u64 offset, u64 size,
+                                             acul::vector<char> &dst)
+    {
+        if (offset > payload_size || size > payload_size - offset) return acul::make_op_error(ACUL_OP_INVALID_SIZE);
+        if (acul::fs::fseek(fd, payload_offset + offset, SEEK_SET) != 0)
+            return acul::make_op_error(ACUL_OP_READ_ERROR);
+
+        dst.resize(static_cast<size_t>(size));
+        if (fread(dst.data(), 1, dst.size(), fd) != dst.size()) return acul::make_op_error(ACUL_OP_READ_ERROR);
+        return acul::make_op_success();
+    }
+
+    UMBF_EXPORT acul::op_result load_library_mapped(const acul::path &path, LibraryMapData &mapping)
+    {
+        close_library_map_fd(mapping);
+        mapping.path = path;
+        mapping.library.reset();
+        mapping.payload_offset = 0;
+        mapping.payload_size = 0;
+        mapping.compressed = false;
+
+        acul::shared_ptr<Block> block;
+        auto result = open_mapped_file(path, sign_block::format::library, sign_block::library, mapping.fd, block,
+                                       mapping.payload_offset, mapping.payload_size, mapping.compressed);
+        if (result.success()) mapping.library = acul::static_pointer_cast<Library>(block);
+        return result;
+    }
+
+    UMBF_EXPORT acul::op_result load_library_mapped_data(const LibraryMapData &mapping,
+                                                        const acul::shared_ptr<Mapping> &node_mapping,
+                                                        acul::vector<char> &dst)
+    {
+        if (!node_mapping) return acul::make_op_error(ACUL_OP_NULLPTR);
+        if (!ensure_library_map_fd(mapping)) return acul::make_op_error(ACUL_OP_READ_ERROR);
+
+        acul::vector<char> src;
+        auto result = read_mapped_range(mapping.fd, mapping.payload_offset, mapping.payload_size,
+                                        node_mapping->offset, node_mapping->size, src);
+        if (!result.success()) return result;
+        if (mapping.compressed) return acul::fs::decompress(src.data(), src.size(), dst);
+
+        dst = std::move(src);
+        return acul::make_op_success();
+    }
+
+    UMBF_EXPORT acul::op_result load_library_mapped_data(const LibraryMapData &mapping, const Library::Node &node,
+                                                        acul::vector<char> &dst)
+    {
+        for (const auto &block : node.asset.blocks)
+        {
+            if (!block) continue;
+            if (block->signature() == sign_block::inline_mapping)
             {
-                close_library_map_fd(mapping);
-                return acul::make_op_error(ACUL_OP_READ_ERROR);
+                dst = static_cast<const InlineMapping *>(block.get())->data;
+                return acul::make_op_success();
             }
+            if (block->signature() == sign_block::mapping)
+                return load_library_mapped_data(mapping, acul::static_pointer_cast<Mapping>(block), dst);
+        }
+        return acul::make_op_error(ACUL_OP_NULLPTR);
+    }
+
+    // Leaf of a mapped library being written
+    struct MappedLibraryEntry
+    {
+        const File *src;
+        File *dst;
+        acul::vector<char> data;
+        bool inlined;
+    };
+
+    // Copies the tree structure and headers, leaf blocks are filled in later
+    static void copy_library_structure(const Library::Node &src, Library::Node &dst,
+                                       acul::vector<MappedLibraryEntry> &entries)
+    {
+        dst.name = src.name;
+        dst.is_folder = src.is_folder;
+        dst.children.resize(src.children.size());
+        for (size_t i = 0; i < src.children.size(); ++i)
+            copy_library_structure(src.children[i], dst.children[i], entries);
+        if (src.children.empty() && !src.is_folder)
+        {
+            dst.asset.header = src.asset.header;
+            entries.push_back({&src.asset, &dst.asset, {}, false});
+        }
+    }
+
+    static void encode_library_entry(MappedLibraryEntry &entry, u64 inline_size, int compression)
+    {
+        acul::bin_stream stream;
+        stream.write(entry.src->blocks);
+        entry.inlined = stream.size() <= inline_size;
+        if (entry.inlined)
+        {
+            entry.data.assign(stream.data(), stream.data() + stream.size());
+            return;
+        }
+        auto cr = acul::fs::compress(stream.data(), stream.size(), entry.data, compression);
+        if (!cr.success())
+            throw acul::runtime_error(
+                acul::format("Failed to compress library entry. Error code: 0x%016" PRIx64, static_cast<u64>(cr)));
+    }
+
+    UMBF_EXPORT bool save_library_mapped(const Library &library, const acul::path &path, u64 inline_size,
+                                         int compression)
+    {
+        try
+        {
+            auto index = acul::make_shared<Library>();
+            acul::vector<MappedLibraryEntry> entries;
+            copy_library_structure(library.file_tree, index->file_tree, entries);
+            oneapi::tbb::parallel_for(size_t(0), entries.size(),
+                                      [&](size_t i) { encode_library_entry(entries[i], inline_size, compression); });
 
-            acul::vector<char> library_buffer(12 + library_block_size);
-            if (fread(library_buffer.data(), 1, library_buffer.size(), mapping.fd) != library_buffer.size())
+            u64 payload_size = 0;
+            for (auto &entry : entries)
             {
-                close_library_map_fd(mapping);
-                return acul::make_op_error(ACUL_OP_READ_ERROR);
+                if (entry.inlined)
+                {
+                    auto inline_mapping = acul::make_shared<InlineMapping>();
+                    inline_mapping->data = std::move(entry.data);
+                    entry.dst->blocks.push_back(inline_mapping);
+                    continue;
+                }
+                auto node_mapping = acul::make_shared<Mapping>();
+                node_mapping->offset = payload_size;
+                node_mapping->size = entry.data.size();
+                entry.dst->blocks.push_back(node_mapping);
+                payload_size += entry.data.size();
             }
 
-            acul::bin_stream library_stream(std::move(library_buffer));
-            acul::shared_ptr<umbf::Block> block;
-            if (umbf::read_next_meta_block(library_stream, block) == 0ULL || !block ||
-                block->signature() != sign_block::library)
+            auto payload = acul::make_shared<RawBlock>(acul::alloc_n<char>(payload_size), payload_size);
+            for (const auto &entry : entries)
             {
-                UMBF_LOG_ERROR("First mapped block must be library");
-                close_library_map_fd(mapping);
-                return acul::make_op_error(ACUL_OP_ERROR_GENERIC);
+                if (entry.inlined) continue;
+                auto node_mapping = acul::static_pointer_cast<Mapping>(entry.dst->blocks.front());
+                memcpy(payload->data + node_mapping->offset, entry.data.data(), entry.data.size());
             }
 
-            mapping.library = acul::static_pointer_cast<Library>(block);
-            const i64 raw_block_offset = acul::fs::ftell(mapping.fd);
-            if (raw_block_offset < 0)
+            File file;
+            file.header.vendor_sign = UMBF_VENDOR_ID;
+            file.header.vendor_version = 0;
+            file.header.spec_version = 0;
+            file.header.type_sign = sign_block::format::library;
+            file.header.flags = UMBF_COMPRESSION_MAPPED_BIT;
+            file.blocks.push_back(index);
+            file.blocks.push_back(payload);
+            return file.save(path.str(), compression);
+        }
+        catch (const std::exception &e)
+        {
+            UMBF_LOG_ERROR("UMBF write error: %s", e.what());
+            return false;
+        }
+    }
+
+    // Objects without bounds use this key and are stored in the shared chunk
+    static constexpr u64 g_unbounded_cell_key = UINT64_MAX;
+
+    // Packs the grid coordinates of the cell containing the center of the bounds, 21 bits per axis
+    static u64 scene_cell_key(const mesh::AABB &bounds, f32 inv_cell_size)
+    {
+        u64 key = 0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const f32 center = (bounds.min[axis] + bounds.max[axis]) * 0.5f;
+            const i64 cell = static_cast<i64>(std::floor(center * inv_cell_size)) + (1 << 20);
+            key = key << 21 | static_cast<u64>(std::clamp(cell, i64(0), i64((1 << 21) - 1)));
+        }
+        return key;
+    }
+
+    namespace
+    {
+        struct SceneChunk
+        {
+            Scene scene;
+            SceneCell cell{};
+            acul::vector<char> data;
+        };
+    } // namespace
+
+    static void encode_scene_chunk(SceneChunk &chunk, int compression)
+    {
+        acul::bin_stream stream;
+        streams::scene.write(stream, &chunk.scene);
+        auto cr = acul::fs::compress(stream.data(), stream.size(), chunk.data, compression);
+        if (!cr.success())
+            throw acul::runtime_error(
+                acul::format("Failed to compress scene cell. Error code: 0x%016" PRIx64, static_cast<u64>(cr)));
+        chunk.cell.raw_size = stream.size();
+        chunk.cell.size = chunk.data.size();
+        chunk.cell.object_count = static_cast<u32>(chunk.scene.objects.size());
+    }
+
+    UMBF_EXPORT bool save_scene_partitioned(const Scene &scene, const acul::path &path, f32 cell_size,
+                                            int compression)
+    {
+        if (!(cell_size > 0.0f))
+        {
+            UMBF_LOG_ERROR("Invalid scene cell size: %f", cell_size);
+            return false;
+        }
+
+        try
+        {
+            const size_t object_count = scene.objects.size();
+            const f32 inv_cell_size = 1.0f / cell_size;
+
+            acul::vector<mesh::AABB> bounds(object_count);
+            acul::vector<u64> keys(object_count);
+            oneapi::tbb::parallel_for(size_t(0), object_count, [&](size_t i) {
+                keys[i] = utils::object_bounds(scene.objects[i], bounds[i]) ? scene_cell_key(bounds[i], inv_cell_size)
+                                                                            : g_unbounded_cell_key;
+            });
+
+            // Sources of instances in the shared chunk must be resident whenever the shared chunk is
+            acul::hashmap<u64, u32> id_slots;
+            for (u32 i = 0; i < object_count; ++i) id_slots.emplace(scene.objects[i].id, i);
+            auto instance_source = [&](const Object &object) -> u32 {
+                for (const auto &block : object.meta)
+                    if (block && block->signature() == sign_block::mesh_instance)
+                    {
+                        auto it = id_slots.find(static_cast<const mesh::Instance *>(block.get())->source);
+                        return it == id_slots.end() ? UINT32_MAX : it->second;
+                    }
+                return UINT32_MAX;
+            };
+            acul::vector<u32> sources(object_count);
+            oneapi::tbb::parallel_for(size_t(0), object_count,
+                                      [&](size_t i) { sources[i] = instance_source(scene.objects[i]); });
+            for (u32 i = 0; i < object_count; ++i)
+                if (keys[i] == g_unbounded_cell_key && sources[i] != UINT32_MAX)
+                    keys[sources[i]] = g_unbounded_cell_key;
+
+            acul::vector<u32> order(object_count);
+            std::iota(order.begin(), order.end(), 0u);
+            std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) { return keys[a] < keys[b]; });
+
+            // Chunk 0 is the shared chunk, the rest follow the cell order
+            acul::vector<u32> object_chunks(object_count);
+            acul::vector<SceneChunk> chunks(1);
+            chunks[0].scene.textures = scene.textures;
+            chunks[0].scene.materials = scene.materials;
+            for (size_t begin = 0; begin < object_count;)
             {
-                close_library_map_fd(mapping);
-                return acul::make_op_error(ACUL_OP_READ_ERROR);
+                const u64 key = keys[order[begin]];
+                size_t end = begin + 1;
+                while (end < object_count && keys[order[end]] == key) ++end;
+                SceneChunk *chunk = &chunks[0];
+                if (key != g_unbounded_cell_key)
+                {
+                    chunk = &chunks.emplace_back();
+                    chunk->cell.bounds = bounds[order[begin]];
+                }
+                for (size_t i = begin; i < end; ++i)
+                {
+                    object_chunks[order[i]] = static_cast<u32>(chunk - chunks.data());
+                    chunk->scene.objects.push_back(scene.objects[order[i]]);
+                    if (key == g_unbounded_cell_key) continue;
+                    chunk->cell.bounds.min = amal::min(chunk->cell.bounds.min, bounds[order[i]].min);
+                    chunk->cell.bounds.max = amal::max(chunk->cell.bounds.max, bounds[order[i]].max);
+                }
+                begin = end;
             }
 
-            u64 raw_block_size = 0;
-            if (fread(&raw_block_size, sizeof(raw_block_size), 1, mapping.fd) != 1 || raw_block_size < sizeof(u64))
+            oneapi::tbb::parallel_for(size_t(0), chunks.size(),
+                                      [&](size_t i) { encode_scene_chunk(chunks[i], compression); });
+
+            u64 payload_size = 0;
+            for (auto &chunk : chunks)
             {
-                close_library_map_fd(mapping);
-                return acul::make_op_error(ACUL_OP_READ_ERROR);
+                chunk.cell.offset = payload_size;
+                payload_size += chunk.cell.size;
             }
 
-            mapping.payload_offset =
-                static_cast<u64>(raw_block_offset) + g_mapped_block_prefix_size + g_raw_block_data_size_field;
-            mapping.payload_size = raw_block_size - g_raw_block_data_size_field;
+            auto index = acul::make_shared<SceneCells>();
+            index->cell_size = cell_size;
+            index->shared = chunks[0].cell;
+            index->cells.resize(chunks.size() - 1);
 
-            if (mapping.payload_size == 0)
+            // Cells that hold the sources of the instances of each cell
+            acul::vector<acul::vector<u32>> dependencies(index->cells.size());
+            for (u32 i = 0; i < object_count; ++i)
             {
-                UMBF_LOG_ERROR("Mapped library metadata is incomplete");
-                close_library_map_fd(mapping);
-                return acul::make_op_error(ACUL_OP_ERROR_GENERIC);
+                if (sources[i] == UINT32_MAX) continue;
+                const u32 chunk = object_chunks[i], source_chunk = object_chunks[sources[i]];
+                if (chunk != 0 && source_chunk != 0 && source_chunk != chunk)
+                    dependencies[chunk - 1].push_back(source_chunk - 1);
             }
+            index->dependency_offsets.resize(index->cells.size() + 1);
+            index->dependency_offsets[0] = 0;
+            for (size_t c = 0; c < dependencies.size(); ++c)
+            {
+                auto &list = dependencies[c];
+                std::sort(list.begin(), list.end());
+                list.erase(std::unique(list.begin(), list.end()), list.end());
+                index->dependencies.insert(index->dependencies.end(), list.begin(), list.end());
+                index->dependency_offsets[c + 1] = static_cast<u32>(index->dependencies.size());
+            }
+            auto payload = acul::make_shared<RawBlock>(acul::alloc_n<char>(payload_size), payload_size);
+            for (size_t i = 0; i < chunks.size(); ++i)
+            {
+                if (i > 0) index->cells[i - 1] = chunks[i].cell;
+                memcpy(payload->data + chunks[i].cell.offset, chunks[i].data.data(), chunks[i].data.size());
+            }
+
+            File file;
+            file.header.vendor_sign = UMBF_VENDOR_ID;
+            file.header.vendor_version = 0;
+            file.header.spec_version = 0;
+            file.header.type_sign = sign_block::format::scene;
+            file.header.flags = UMBF_COMPRESSION_MAPPED_BIT;
+            file.blocks.push_back(index);
+            file.blocks.push_back(payload);
+            return file.save(path.str(), compression);
         }
-        catch (std::exception &e)
+        catch (const std::exception &e)
+        {
+            UMBF_LOG_ERROR("UMBF write error: %s", e.what());
+            return false;
+        }
+    }
+
+    static acul::op_result decode_scene_chunk(const acul::vector<char> &src, bool compressed,
+                                              acul::shared_ptr<Scene> &dst)
+    {
+        acul::vector<char> decoded;
+        if (compressed)
+        {
+            auto result = acul::fs::decompress(src.data(), src.size(), decoded);
+            if (!result.success()) return result;
+        }
+        else
+            decoded = src;
+
+        try
+        {
+            acul::bin_stream stream(std::move(decoded));
+            dst = acul::shared_ptr<Scene>(static_cast<Scene *>(streams::scene.read(stream)));
+        }
+        catch (const std::exception &e)
         {
             UMBF_LOG_ERROR("%s", e.what());
-            close_library_map_fd(mapping);
             return acul::make_op_error(ACUL_OP_ERROR_GENERIC);
         }
         return acul::make_op_success();
     }
 
-    UMBF_EXPORT acul::op_result load_library_mapped_data(const LibraryMapData &mapping,
-                                                        const acul::shared_ptr<Mapping> &node_mapping,
-                                                        acul::vector<char> &dst)
+    acul::op_result SceneStreamer::open(const acul::path &path)
     {
-        if (!node_mapping) return acul::make_op_error(ACUL_OP_NULLPTR);
-        if (!ensure_library_map_fd(mapping)) return acul::make_op_error(ACUL_OP_READ_ERROR);
-        if (node_mapping->offset > mapping.payload_size ||
-            node_mapping->size > mapping.payload_size - node_mapping->offset)
-            return acul::make_op_error(ACUL_OP_INVALID_SIZE);
+        close();
+        acul::shared_ptr<Block> block;
+        auto result = open_mapped_file(path, sign_block::format::scene, sign_block::scene_cells, _fd, block,
+                                       _payload_offset, _payload_size, _compressed);
+        if (!result.success()) return result;
+        _index = acul::static_pointer_cast<SceneCells>(block);
 
-        const u64 offset = mapping.payload_offset + node_mapping->offset;
-        if (acul::fs::fseek(mapping.fd, offset, SEEK_SET) != 0) return acul::make_op_error(ACUL_OP_READ_ERROR);
+        acul::vector<char> src;
+        const auto &shared = _index->shared;
+        result = read_mapped_range(_fd, _payload_offset, _payload_size, shared.offset, shared.size, src);
+        if (result.success()) result = decode_scene_chunk(src, _compressed, _shared);
+        if (!result.success())
+        {
+            close();
+            return result;
+        }
+        _cells.resize(_index->cells.size());
+        return result;
+    }
 
-        acul::vector<char> src(static_cast<size_t>(node_mapping->size));
-        if (fread(src.data(), 1, src.size(), mapping.fd) != src.size())
-            return acul::make_op_error(ACUL_OP_READ_ERROR);
+    void SceneStreamer::close()
+    {
+        if (_fd) fclose(_fd);
+        _fd = nullptr;
+        _payload_offset = 0;
+        _payload_size = 0;
+        _resident_size = 0;
+        _index.reset();
+        _shared.reset();
+        _cells.clear();
+        _resident.clear();
+    }
 
-        if (mapping.compressed) return acul::fs::decompress(src.data(), src.size(), dst);
+    // Distance from a point to a box, zero inside
+    static f32 distance_to_bounds(const amal::vec3 &point, const mesh::AABB &bounds)
+    {
+        const amal::vec3 d = amal::max(amal::max(bounds.min - point, point - bounds.max), amal::vec3(0.0f));
+        return amal::sqrt(amal::dot(d, d));
+    }
 
-        dst = std::move(src);
-        return acul::make_op_success();
+    acul::op_result SceneStreamer::update(const amal::vec3 &position, f32 radius)
+    {
+        if (!_index) return acul::make_op_error(ACUL_OP_NULLPTR);
+
+        struct Candidate
+        {
+            f32 distance;
+            u32 cell;
+        };
+        acul::vector<Candidate> candidates;
+        for (u32 i = 0; i < _index->cells.size(); ++i)
+        {
+            const f32 distance = distance_to_bounds(position, _index->cells[i].bounds);
+            if (distance <= radius) candidates.push_back({distance, i});
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+            return a.distance < b.distance || (a.distance == b.distance && a.cell < b.cell);
+        });
+
+        // Nearest cells first together with the cells of their instance sources, stop at the first cell that
+        // does not fit
+        acul::vector<u8> wanted(_cells.size(), 0);
+        acul::vector<u32> group, stack;
+        u64 wanted_size = 0;
+        for (const auto &candidate : candidates)
+        {
+            group.clear();
+            stack.assign(1, candidate.cell);
+            u64 size = 0;
+            while (!stack.empty())
+            {
+                const u32 cell = stack.back();
+                stack.pop_back();
+                if (wanted[cell] || std::find(group.begin(), group.end(), cell) != group.end()) continue;
+                group.push_back(cell);
+                size += _index->cells[cell].raw_size;
+                for (u32 d = _index->dependency_offsets[cell]; d < _index->dependency_offsets[cell + 1]; ++d)
+                    stack.push_back(_index->dependencies[d]);
+            }
+            if (wanted_size + size > _budget) break;
+            wanted_size += size;
+            for (u32 cell : group) wanted[cell] = 1;
+        }
+
+        acul::vector<u32> resident;
+        for (u32 cell : _resident)
+            if (wanted[cell])
+                resident.push_back(cell);
+            else
+            {
+                _cells[cell].reset();
+                _resident_size -= _index->cells[cell].raw_size;
+            }
+
+        // Chunks are read sequentially and decoded in parallel
+        acul::vector<u32> loads;
+        acul::vector<acul::vector<char>> sources;
+        auto result = acul::make_op_success();
+        for (u32 c = 0; c < _cells.size(); ++c)
+        {
+            if (!wanted[c] || _cells[c]) continue;
+            const auto &cell = _index->cells[c];
+            acul::vector<char> src;
+            auto read_result = read_mapped_range(_fd, _payload_offset, _payload_size, cell.offset, cell.size, src);
+            if (!read_result.success())
+            {
+                result = read_result;
+                continue;
+            }
+            loads.push_back(c);
+            sources.push_back(std::move(src));
+        }
+
+        acul::vector<acul::op_result> results(loads.size(), acul::make_op_success());
+        oneapi::tbb::parallel_for(size_t(0), loads.size(), [&](size_t i) {
+            results[i] = decode_scene_chunk(sources[i], _compressed, _cells[loads[i]]);
+        });
+        for (size_t i = 0; i < loads.size(); ++i)
+        {
+            if (!results[i].success())
+            {
+                _cells[loads[i]].reset();
+                result = results[i];
+                continue;
+            }
+            resident.push_back(loads[i]);
+            _resident_size += _index->cells[loads[i]].raw_size;
+        }
+        _resident = std::move(resident);
+        if (!loads.empty()) resolve_resident_instances();
+        return result;
+    }
+
+    void SceneStreamer::resolve_resident_instances()
+    {
+        acul::hashmap<u64, acul::shared_ptr<mesh::Mesh>> meshes;
+        auto collect = [&meshes](const Scene &scene) {
+            for (const auto &object : scene.objects)
+                for (const auto &block : object.meta)
+                    if (block && block->signature() == sign_block::mesh)
+                    {
+                        meshes.emplace(object.id, acul::static_pointer_cast<mesh::Mesh>(block));
+                        break;
+                    }
+        };
+        collect(*_shared);
+        for (u32 cell : _resident) collect(*_cells[cell]);
+
+        auto resolve = [&meshes](Scene &scene) {
+            for (u32 index : scene.objects_with(sign_block::mesh_instance))
+                for (auto &block : scene.objects[index].meta)
+                {
+                    if (!block || block->signature() != sign_block::mesh_instance) continue;
+                    auto *instance = static_cast<mesh::Instance *>(block.get());
+                    auto it = meshes.find(instance->source);
+                    instance->mesh = it == meshes.end() ? nullptr : it->second;
+                }
+        };
+        resolve(*_shared);
+        for (u32 cell : _resident) resolve(*_cells[cell]);
     }
 
     void fill_atlas_pixels(const acul::shared_ptr<Image2D> &image, const acul::shared_ptr<Atlas> &atlas,
@@ -331,6 +799,188 @@ namespace umbf
         }
     }
 
+    mesh::IndexBuffer::IndexBuffer(const acul::vector<u32> &indices, size_t vertex_count)
+    {
+        using range = oneapi::tbb::blocked_range<size_t>;
+        _is_16bit = vertex_count <= max_16bit_vertices;
+        if (!_is_16bit)
+        {
+            _indices32 = indices;
+            return;
+        }
+        _indices16.resize(indices.size());
+        oneapi::tbb::parallel_for(range(0, indices.size()), [&](const range &r) {
+            for (size_t i = r.begin(); i < r.end(); ++i) _indices16[i] = static_cast<u16>(indices[i]);
+        });
+    }
+
+    void mesh::IndexBuffer::unpack(acul::vector<u32> &dst) const
+    {
+        using range = oneapi::tbb::blocked_range<size_t>;
+        if (!_is_16bit)
+        {
+            dst = _indices32;
+            return;
+        }
+        dst.resize(_indices16.size());
+        oneapi::tbb::parallel_for(range(0, dst.size()), [&](const range &r) {
+            for (size_t i = r.begin(); i < r.end(); ++i) dst[i] = _indices16[i];
+        });
+    }
+
+    const mesh::VertexStream *mesh::VertexAttributes::find(VertexAttribute::enum_type attribute,
+                                                           const VertexElement **element) const
+    {
+        for (const auto &stream : streams)
+            for (const auto &candidate : stream.elements)
+                if (candidate.attribute == attribute)
+                {
+                    if (element) *element = &candidate;
+                    return &stream;
+                }
+        return nullptr;
+    }
+
+    FaceSet::FaceSet(const acul::vector<u32> &faces)
+    {
+        if (faces.empty()) return;
+        const acul::vector<u32> *sorted = &faces;
+        acul::vector<u32> copy;
+        if (!std::is_sorted(faces.begin(), faces.end()))
+        {
+            copy = faces;
+            oneapi::tbb::parallel_sort(copy.begin(), copy.end());
+            sorted = &copy;
+        }
+
+        Run run{sorted->front(), 1};
+        for (size_t i = 1; i < sorted->size(); ++i)
+        {
+            const u32 face = (*sorted)[i];
+            const u64 end = static_cast<u64>(run.first) + run.count;
+            if (face < end) continue;
+            if (face == end)
+                ++run.count;
+            else
+            {
+                runs.push_back(run);
+                run = {face, 1};
+            }
+        }
+        runs.push_back(run);
+    }
+
+    bool FaceSet::contains(u32 face) const
+    {
+        auto it = std::upper_bound(runs.begin(), runs.end(), face,
+                                   [](u32 value, const Run &run) { return value < run.first; });
+        if (it == runs.begin()) return false;
+        --it;
+        return face - it->first < it->count;
+    }
+
+    u64 FaceSet::size() const
+    {
+        u64 size = 0;
+        for (const auto &run : runs) size += run.count;
+        return size;
+    }
+
+    FaceSet FaceSet::complement(u32 face_count) const
+    {
+        FaceSet dst;
+        u32 next = 0;
+        for (const auto &run : runs)
+        {
+            if (run.first >= face_count) break;
+            if (run.first > next) dst.runs.push_back({next, run.first - next});
+            next = static_cast<u32>(amal::min(static_cast<u64>(run.first) + run.count, static_cast<u64>(face_count)));
+        }
+        if (next < face_count) dst.runs.push_back({next, face_count - next});
+        return dst;
+    }
+
+    void FaceSet::append_to(acul::vector<u32> &dst) const
+    {
+        const size_t offset = dst.size();
+        dst.resize(offset + size());
+        u32 *out = dst.data() + offset;
+        for (const auto &run : runs)
+            for (u32 i = 0; i < run.count; ++i) *out++ = run.first + i;
+    }
+
+    void Scene::build_lookup() const
+    {
+        if (_lookup.valid && _lookup.object_count == objects.size()) return;
+        _lookup.ids.clear();
+        _lookup.names.clear();
+        _lookup.signatures.clear();
+        for (u32 i = 0; i < objects.size(); ++i)
+        {
+            const Object &object = objects[i];
+            _lookup.ids.emplace(object.id, i);
+            _lookup.names.emplace(object.name, i);
+            for (const auto &block : object.meta)
+            {
+                if (!block) continue;
+                auto &list = _lookup.signatures[block->signature()];
+                if (list.empty() || list.back() != i) list.push_back(i);
+            }
+        }
+        _lookup.object_count = objects.size();
+        _lookup.valid = true;
+    }
+
+    Object *Scene::find_object(u64 id)
+    {
+        return const_cast<Object *>(static_cast<const Scene *>(this)->find_object(id));
+    }
+
+    const Object *Scene::find_object(u64 id) const
+    {
+        build_lookup();
+        auto it = _lookup.ids.find(id);
+        if (it == _lookup.ids.end()) return nullptr;
+        if (objects[it->second].id != id)
+        {
+            // The index is stale, the object was edited or moved without invalidate_lookup()
+            _lookup.valid = false;
+            build_lookup();
+            it = _lookup.ids.find(id);
+            if (it == _lookup.ids.end()) return nullptr;
+        }
+        return &objects[it->second];
+    }
+
+    Object *Scene::find_object(const acul::string &name)
+    {
+        return const_cast<Object *>(static_cast<const Scene *>(this)->find_object(name));
+    }
+
+    const Object *Scene::find_object(const acul::string &name) const
+    {
+        build_lookup();
+        auto it = _lookup.names.find(name);
+        if (it == _lookup.names.end()) return nullptr;
+        if (objects[it->second].name != name)
+        {
+            // The index is stale, the object was edited or moved without invalidate_lookup()
+            _lookup.valid = false;
+            build_lookup();
+            it = _lookup.names.find(name);
+            if (it == _lookup.names.end()) return nullptr;
+        }
+        return &objects[it->second];
+    }
+
+    const acul::vector<u32> &Scene::objects_with(u32 signature) const
+    {
+        static const acul::vector<u32> empty;
+        build_lookup();
+        auto it = _lookup.signatures.find(signature);
+        return it == _lookup.signatures.end() ? empty : it->second;
+    }
+
     Library::Node *Library::get_node(const acul::path &path)
     {
         Node *current_node = &file_tree;
@@ -395,6 +1045,164 @@ namespace umbf
             }
         }
     }
+    // Leaf assets in the order they are written
+    static void collect_library_assets(const Library::Node &node, acul::vector<const File *> &assets)
+    {
+        if (!node.children.empty())
+            for (const auto &child : node.children) collect_library_assets(child, assets);
+        else if (!node.is_folder)
+            assets.push_back(&node.asset);
+    }
+
+    // Serializes leaf assets in parallel into separate buffers, in depth-first order. Invalid assets are left empty.
+    static acul::vector<acul::bin_stream> serialize_library_assets(const Library::Node &root)
+    {
+        acul::vector<const File *> assets;
+        collect_library_assets(root, assets);
+        acul::vector<acul::bin_stream> buffers(assets.size());
+        oneapi::tbb::parallel_for(size_t(0), assets.size(), [&](size_t i) {
+            if (assets[i]->header.type_sign != sign_block::format::none) buffers[i].write(*assets[i]);
+        });
+        return buffers;
+    }
+
+    // Node header: name, folder flag, child count and the byte size of the children or the asset
+    static u64 library_node_header_size(const Library::Node &node)
+    {
+        acul::bin_stream header;
+        header.write(node.name).write(node.is_folder).write(u16(0)).write(u64(0));
+        return header.size();
+    }
+
+    // Stores body sizes of all nodes in pre-order and returns the encoded size of the subtree
+    static u64 measure_library_node(const Library::Node &node, const acul::vector<acul::bin_stream> &assets,
+                                    size_t &next_asset, acul::vector<u64> &body_sizes)
+    {
+        const size_t slot = body_sizes.size();
+        body_sizes.push_back(0);
+        u64 body_size = 0;
+        if (!node.children.empty())
+            for (const auto &child : node.children)
+                body_size += measure_library_node(child, assets, next_asset, body_sizes);
+        else if (!node.is_folder)
+            body_size = assets[next_asset++].size();
+        body_sizes[slot] = body_size;
+        return library_node_header_size(node) + body_size;
+    }
+
+    static void write_library_node(acul::bin_stream &stream, const Library::Node &node,
+                                   acul::vector<acul::bin_stream> &assets, const acul::vector<u64> &body_sizes,
+                                   size_t &next_node, size_t &next_asset)
+    {
+        if (node.children.size() > UINT16_MAX)
+            throw acul::runtime_error(acul::format("Too many children in library node: %s", node.name.c_str()));
+        const u16 child_count = static_cast<u16>(node.children.size());
+        stream.write(node.name).write(node.is_folder).write(child_count).write(body_sizes[next_node++]);
+        if (child_count > 0)
+            for (const auto &child : node.children)
+                write_library_node(stream, child, assets, body_sizes, next_node, next_asset);
+        else if (!node.is_folder)
+        {
+            if (node.asset.header.type_sign == sign_block::format::none)
+                throw acul::runtime_error("Umbf asset is invalid. Possible corrupted file structure");
+            auto &asset = assets[next_asset++];
+            stream.write(asset.data(), asset.size());
+            asset = acul::bin_stream();
+        }
+    }
+
+    void write_library_tree(acul::bin_stream &stream, const Library::Node &root)
+    {
+        auto assets = serialize_library_assets(root);
+        acul::vector<u64> body_sizes;
+        size_t next_asset = 0;
+        measure_library_node(root, assets, next_asset, body_sizes);
+        size_t next_node = 0;
+        next_asset = 0;
+        write_library_node(stream, root, assets, body_sizes, next_node, next_asset);
+    }
+
+    static void read_library_node_header(acul::bin_stream &stream, Library::Node &node, u16 &child_count,
+                                         u64 &body_size)
+    {
+        stream.read(node.name).read(node.is_folder).read(child_count).read(body_size);
+        if (body_size > stream.size() - stream.pos())
+            throw acul::runtime_error(acul::format("Library node exceeds the stream: %s", node.name.c_str()));
+    }
+
+    // Encoded asset of a leaf node
+    struct LibraryAssetRange
+    {
+        File *asset;
+        size_t offset;
+        size_t size;
+    };
+
+    // Reads node headers and records the asset ranges of leaves without parsing them
+    static void read_library_skeleton(acul::bin_stream &stream, Library::Node &node,
+                                      acul::vector<LibraryAssetRange> &ranges)
+    {
+        u16 child_count;
+        u64 body_size;
+        read_library_node_header(stream, node, child_count, body_size);
+        const size_t end = stream.pos() + body_size;
+        if (child_count > 0)
+        {
+            node.children.resize(child_count);
+            for (auto &child : node.children) read_library_skeleton(stream, child, ranges);
+            if (stream.pos() != end)
+                throw acul::runtime_error(acul::format("Library node size mismatch: %s", node.name.c_str()));
+        }
+        else if (!node.is_folder)
+            ranges.push_back({&node.asset, stream.pos(), static_cast<size_t>(body_size)});
+        stream.pos(end);
+    }
+
+    void read_library_tree(acul::bin_stream &stream, Library::Node &root)
+    {
+        acul::vector<LibraryAssetRange> ranges;
+        read_library_skeleton(stream, root, ranges);
+        oneapi::tbb::parallel_for(size_t(0), ranges.size(), [&](size_t i) {
+            const char *data = stream.data() + ranges[i].offset;
+            acul::bin_stream asset(acul::vector<char>(data, data + ranges[i].size));
+            asset.read(*ranges[i].asset);
+            if (ranges[i].asset->header.type_sign == sign_block::format::none)
+                throw acul::runtime_error("Umbf file is invalid. Possible corrupted file structure");
+        });
+    }
+
+    bool read_library_node(acul::bin_stream &stream, const acul::path &path, Library::Node &dst)
+    {
+        size_t node_pos = stream.pos();
+        for (const auto &it : path)
+        {
+            Library::Node node;
+            u16 child_count;
+            u64 body_size;
+            stream.pos(node_pos);
+            read_library_node_header(stream, node, child_count, body_size);
+            bool found = false;
+            for (u16 i = 0; i < child_count && !found; ++i)
+            {
+                const size_t child_pos = stream.pos();
+                Library::Node child;
+                u16 child_children;
+                u64 child_size;
+                read_library_node_header(stream, child, child_children, child_size);
+                if (child.name == it)
+                {
+                    node_pos = child_pos;
+                    found = true;
+                }
+                else
+                    stream.shift(child_size);
+            }
+            if (!found) return false;
+        }
+        stream.pos(node_pos);
+        read_library_tree(stream, dst);
+        return true;
+    }
 } // namespace umbf
 
 namespace acul
@@ -493,6 +1301,16 @@ namespace acul
         return *this;
     }
 
+    template <>
+    bin_stream &bin_stream::write(const vector<umbf::File> &assets)
+    {
+        if (assets.size() > UINT16_MAX)
+            throw acul::runtime_error(acul::format("Too many embedded files: %zu", assets.size()));
+        write(static_cast<u16>(assets.size()));
+        for (auto &asset : assets) write(asset);
+        return *this;
+    }
+
     template <>
     bin_stream &bin_stream::read(vector<umbf::File> &dst)
     {
@@ -513,23 +1331,37 @@ namespace acul
         return *this;
     }
 
-    template <>
-    bin_stream &bin_stream::write(const umbf::Library::Node &node)
+    static void write_library_node_v1(bin_stream &stream, const umbf::Library::Node &node,
+                                      vector<bin_stream> &assets, size_t &next_asset)
     {
-        write(node.name).write(node.is_folder);
+        stream.write(node.name).write(node.is_folder);
+        if (node.children.size() > UINT16_MAX)
+            throw acul::runtime_error(acul::format("Too many children in library node: %s", node.name.c_str()));
         u16 child_count = static_cast<u16>(node.children.size());
-        write(child_count);
+        stream.write(child_count);
         if (child_count > 0)
-            for (const auto &child : node.children) write(child);
+            for (const auto &child : node.children) write_library_node_v1(stream, child, assets, next_asset);
         else
         {
             if (!node.is_folder)
             {
                 if (node.asset.header.type_sign == umbf::sign_block::format::none)
                     throw acul::runtime_error("Umbf asset is invalid. Possible corrupted file structure");
-                write(node.asset);
+                auto &asset = assets[next_asset++];
+                stream.write(asset.data(), asset.size());
+                asset = bin_stream();
             }
         }
+    }
+
+    // Leaf assets are serialized in parallel into separate buffers, then stitched in tree order.
+    // The output matches a serial depth-first write.
+    template <>
+    bin_stream &bin_stream::write(const umbf::Library::Node &node)
+    {
+        auto buffers = umbf::serialize_library_assets(node);
+        size_t next_asset = 0;
+        write_library_node_v1(*this, node, buffers, next_asset);
         return *this;
     }
 
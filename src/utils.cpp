@@ -1,4 +1,5 @@
 #include <acul/log.hpp>
+#include <algorithm>
 #include <amal/half.hpp>
 #include <numeric>
 #include <oneapi/tbb/parallel_for.h>
@@ -193,43 +194,43 @@ namespace umbf
         void filter_mat_assignments(const acul::vector<acul::shared_ptr<MaterialRange>> &assignes, size_t face_count,
                                     u64 default_id, acul::vector<acul::shared_ptr<MaterialRange>> &dst)
         {
-            auto default_assign = acul::make_shared<MaterialRange>();
-            default_assign->mat_id = default_id;
-            default_assign->faces.resize(face_count);
-            std::iota(default_assign->faces.begin(), default_assign->faces.end(), 0);
-
-            if (assignes.empty())
-                dst.push_back(default_assign);
-            else
-            {
-                acul::vector<bool> face_included(face_count, false);
-
-                for (const auto &assign : assignes)
-                    for (u32 face : assign->faces)
-                        if (face < face_count) face_included[face] = true;
-                default_assign->faces.erase(std::remove_if(default_assign->faces.begin(), default_assign->faces.end(),
-                                                           [&](u32 index) { return face_included[index]; }),
-                                            default_assign->faces.end());
-                if (!default_assign->faces.empty()) dst.push_back(default_assign);
-                for (const auto &assign : assignes) dst.push_back(assign);
-            }
-        }
-
-        namespace mesh
-        {
-            void fill_vertex_groups(const Model &model, acul::vector<VertexGroup> &groups)
+            // Unassigned faces are the complement of the union of all assignments. Face lists are usually
+            // ascending, so the sets are built without sorting and only their runs are merged.
+            acul::vector<FaceSet> sets(assignes.size());
+            oneapi::tbb::parallel_for(size_t(0), assignes.size(),
+                                      [&](size_t i) { sets[i] = FaceSet(assignes[i]->faces); });
+            acul::vector<FaceSet::Run> runs;
+            for (const auto &set : sets) runs.insert(runs.end(), set.runs.begin(), set.runs.end());
+            std::sort(runs.begin(), runs.end(),
+                      [](const FaceSet::Run &a, const FaceSet::Run &b) { return a.first < b.first; });
+
+            FaceSet assigned;
+            for (const auto &run : runs)
             {
-                groups.resize(model.group_count);
-                for (size_t f = 0; f < model.faces.size(); ++f)
+                if (!assigned.runs.empty())
                 {
-                    for (const auto &vref : model.faces[f].vertices)
+                    auto &last = assigned.runs.back();
+                    const u64 end = static_cast<u64>(last.first) + last.count;
+                    if (run.first <= end)
                     {
-                        groups[vref.group].faces.push_back(f);
-                        groups[vref.group].vertices.push_back(vref.vertex);
+                        const u64 run_end = static_cast<u64>(run.first) + run.count;
+                        if (run_end > end) last.count = static_cast<u32>(run_end - last.first);
+                        continue;
                     }
                 }
+                assigned.runs.push_back(run);
+            }
+            const FaceSet unassigned = assigned.complement(static_cast<u32>(face_count));
+
+            if (assignes.empty() || !unassigned.runs.empty())
+            {
+                auto default_assign = acul::make_shared<MaterialRange>();
+                default_assign->mat_id = default_id;
+                unassigned.append_to(default_assign->faces);
+                dst.push_back(default_assign);
             }
-        } // namespace mesh
+            for (const auto &assign : assignes) dst.push_back(assign);
+        }
 
         struct SkylineCandidate
         {